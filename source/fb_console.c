@@ -1,32 +1,87 @@
 #include "fb_console.h"
 
 #include "defs.h"
+#include "font.h"
+#include "glyph_cache.h"
+#include "platform.h"
 #include "utility.h"
 #include "virtio_gpu.h"
 #include "memory.h"
+#include "utf8.h"
 
-#define GLYPH_W 8u
-#define GLYPH_H 16u
+typedef TerminalCell Cell;
+
+// damage is tracked per tile and merged into a few rectangles at flush time
+#define DAMAGE_TILE_W 64u
+#define DAMAGE_TILE_H 32u
+#define DAMAGE_MAX_RECTS VIRTIO_GPU_MAX_PRESENT_RECTS
 
 typedef struct
 {
-    char c;
-    uint8_t color;
-} Cell;
-
-static FramebufferInfo _framebuffer;
-static bool _framebuffer_ok = false;
+    uint32_t x0, y0, x1, y1;
+} DamageRect;
 
-static Cell* _cells;
-static size_t _columns;
-static size_t _rows;
+// draws one whole glyph cell; rows starts at the cell's top pixel row
+typedef void (*GlyphBlitter)(const uint8_t* glyph, uint32_t* const* rows, uint32_t pixel_x,
+                             uint32_t foreground, uint32_t background);
 
-static bool _dirty;
-static uint32_t _dirty_x0, _dirty_y0, _dirty_x1, _dirty_y1;
+// One per display head, indexed by scanout id. Each has its own framebuffer,
+// cell grid and damage map; the public calls draw into the selected one.
+typedef struct
+{
+    bool ok;
+    FramebufferInfo framebuffer;
+
+    // font_choice is what the owner asked for (null picks by resolution);
+    // font and blit are what the current geometry was built with
+    const Font* font_choice;
+    const Font* font;
+    GlyphBlitter blit;
+
+    Cell* cells;
+    size_t cells_capacity;
+    size_t columns;
+    size_t rows;
+
+    // cells whose content changed since the last flush; they are only
+    // rasterized when the frame goes out
+    uint32_t* dirty_cells;
+    size_t dirty_cells_capacity;
+    size_t cell_words_per_row;
+
+    bool dirty;
+    // the software caret changed since the last flush
+    bool caret_damage;
+    uint32_t* dirty_tiles;
+    size_t dirty_tiles_capacity;
+    uint32_t tile_columns;
+    uint32_t tile_rows;
+    uint32_t tile_words_per_row;
+} TerminalDisplay;
+
+static TerminalDisplay _displays[VIRTIO_GPU_MAX_SCANOUTS];
+static size_t _display_count;
+static TerminalDisplay* _display = &_displays[0];
+
+static TerminalResizeHandler _resize_handler;
+
+static TerminalFlushStats _flush_stats;
+
+// frame scheduler: damage accumulates between frames and is presented at most
+// once per refresh period
+static uint32_t _frame_period = PLATFORM_TIMER_HZ / TERMINAL_DEFAULT_REFRESH_HZ;
+static uint32_t _next_frame;
 
 static inline Cell* cell_at(size_t x, size_t y)
 {
-    return &_cells[y * _columns + x];
+    return &_display->cells[y * _display->columns + x];
+}
+
+// a present leaves the new back buffer to be caught up with the last frame;
+// every pixel writer goes through here before its first write
+static void begin_drawing(TerminalDisplay* display)
+{
+    virtio_gpu_prepare_back((uint32_t)(display - _displays));
 }
 
 static const uint32_t _vga16_xrgb[16] =
@@ -49,83 +104,245 @@ static const uint32_t _vga16_xrgb[16] =
     0x00FFFFFFu, // white
 };
 
-static inline uint32_t fg_from_color(uint8_t color)
+// the VGA colors followed by the xterm cube and grey ramp, filled in by
+// palette_init
+static uint32_t _palette_xrgb[256];
+
+// Resolved pixels for recently drawn fg/bg combinations. A run that moves
+// between a handful of colors finds them here instead of decoding both
+// colors again every time they change.
+#define COLOR_PAIR_CACHE_SIZE 16u
+
+typedef struct
+{
+    TerminalColor fg, bg;
+    uint32_t foreground, background;
+} ColorPair;
+
+static ColorPair _color_pairs[COLOR_PAIR_CACHE_SIZE];
+
+static void palette_init(void)
+{
+    static const uint8_t levels[6] = { 0x00, 0x5F, 0x87, 0xAF, 0xD7, 0xFF };
+
+    memcpy(_palette_xrgb, _vga16_xrgb, sizeof(_vga16_xrgb));
+
+    for (uint32_t i = 0; i < 216; i++)
+    {
+        _palette_xrgb[16 + i] = ((uint32_t)levels[i / 36] << 16) | ((uint32_t)levels[(i / 6) % 6] << 8) | levels[i % 6];
+    }
+
+    for (uint32_t i = 0; i < 24; i++)
+    {
+        const uint32_t level = 8 + i * 10;
+        _palette_xrgb[232 + i] = (level << 16) | (level << 8) | level;
+    }
+
+    // no valid color has bits above the RGB flag, so these never match
+    for (size_t i = 0; i < COLOR_PAIR_CACHE_SIZE; i++)
+    {
+        _color_pairs[i].fg = ~0u;
+        _color_pairs[i].bg = ~0u;
+    }
+}
+
+static inline uint32_t xrgb_from_color(TerminalColor color)
+{
+    return (color & TERMINAL_COLOR_RGB) ? (color & 0x00FFFFFFu) : _palette_xrgb[color & 0xFFu];
+}
+
+static inline const ColorPair* color_pair(TerminalColor fg, TerminalColor bg)
 {
-    return _vga16_xrgb[color & 0x0Fu];
+    const uint32_t hash = (fg * 0x9E3779B1u) ^ (bg * 0x85EBCA77u);
+    ColorPair* pair = &_color_pairs[hash >> 28];
+
+    if (pair->fg != fg || pair->bg != bg)
+    {
+        pair->fg = fg;
+        pair->bg = bg;
+        pair->foreground = xrgb_from_color(fg);
+        pair->background = xrgb_from_color(bg);
+    }
+
+    return pair;
 }
 
-static inline uint32_t bg_from_color(uint8_t color)
+// nearest of the 16 attribute colors, for reading cells back as a byte
+static uint8_t vga_from_color(TerminalColor color)
 {
-    return _vga16_xrgb[(color >> 4) & 0x0Fu];
+    if (color < 16u)
+    {
+        return (uint8_t)color;
+    }
+
+    const uint32_t xrgb = xrgb_from_color(color);
+    uint8_t best = 0;
+    uint32_t best_distance = UINT32_MAX;
+
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        const int32_t dr = (int32_t)((xrgb >> 16) & 0xFFu) - (int32_t)((_vga16_xrgb[i] >> 16) & 0xFFu);
+        const int32_t dg = (int32_t)((xrgb >> 8) & 0xFFu) - (int32_t)((_vga16_xrgb[i] >> 8) & 0xFFu);
+        const int32_t db = (int32_t)(xrgb & 0xFFu) - (int32_t)(_vga16_xrgb[i] & 0xFFu);
+        const uint32_t distance = (uint32_t)(dr * dr + dg * dg + db * db);
+
+        if (distance < best_distance)
+        {
+            best = i;
+            best_distance = distance;
+        }
+    }
+
+    return best;
 }
 
 static inline void mark_dirty_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h)
 {
-    if (!_framebuffer_ok) 
+    if (!_display->ok || w == 0 || h == 0) 
     {
         return;
     }
 
-    if (!_dirty)
+    const uint32_t tx0 = x / DAMAGE_TILE_W;
+    const uint32_t ty0 = y / DAMAGE_TILE_H;
+    uint32_t tx1 = (x + w - 1) / DAMAGE_TILE_W;
+    uint32_t ty1 = (y + h - 1) / DAMAGE_TILE_H;
+
+    if (tx0 >= _display->tile_columns || ty0 >= _display->tile_rows)
     {
-        _dirty = true;
-        _dirty_x0 = x;
-        _dirty_y0 = y;
-        _dirty_x1 = x + w;
-        _dirty_y1 = y + h;
         return;
     }
+    if (tx1 >= _display->tile_columns)
+    {
+        tx1 = _display->tile_columns - 1;
+    }
+    if (ty1 >= _display->tile_rows)
+    {
+        ty1 = _display->tile_rows - 1;
+    }
 
-    if (x < _dirty_x0)
+    for (uint32_t ty = ty0; ty <= ty1; ty++)
     {
-        _dirty_x0 = x;
+        uint32_t* row = &_display->dirty_tiles[ty * _display->tile_words_per_row];
+        for (uint32_t tx = tx0; tx <= tx1; tx++)
+        {
+            row[tx / 32u] |= 1u << (tx % 32u);
+        }
     }
-    if (y < _dirty_y0)
+
+    _display->dirty = true;
+}
+
+static inline bool tile_dirty(const uint32_t* row, uint32_t tx)
+{
+    return (row[tx / 32u] >> (tx % 32u)) & 1u;
+}
+
+static inline uint32_t rect_area(const DamageRect* rect)
+{
+    return (rect->x1 - rect->x0) * (rect->y1 - rect->y0);
+}
+
+static void add_damage_rect(DamageRect* rects, size_t* count, DamageRect rect)
+{
+    // extend a rectangle from the tile row above when the run lines up exactly
+    for (size_t i = 0; i < *count; i++)
     {
-        _dirty_y0 = y;
+        if (rects[i].x0 == rect.x0 && rects[i].x1 == rect.x1 && rects[i].y1 == rect.y0)
+        {
+            rects[i].y1 = rect.y1;
+            return;
+        }
     }
-    if (x + w > _dirty_x1)
+
+    if (*count < DAMAGE_MAX_RECTS)
     {
-        _dirty_x1 = x + w;
+        rects[(*count)++] = rect;
+        return;
     }
-    if (y + h > _dirty_y1) 
+
+    // out of rectangles: fold into whichever one grows the least
+    size_t best = 0;
+    uint32_t best_growth = 0xffffffffu;
+
+    for (size_t i = 0; i < *count; i++)
     {
-        _dirty_y1 = y + h;
+        DamageRect merged =
+        {
+            (uint32_t)min(rects[i].x0, rect.x0), (uint32_t)min(rects[i].y0, rect.y0),
+            (uint32_t)max(rects[i].x1, rect.x1), (uint32_t)max(rects[i].y1, rect.y1),
+        };
+
+        const uint32_t growth = rect_area(&merged) - rect_area(&rects[i]);
+        if (growth < best_growth)
+        {
+            best = i;
+            best_growth = growth;
+        }
     }
+
+    rects[best].x0 = (uint32_t)min(rects[best].x0, rect.x0);
+    rects[best].y0 = (uint32_t)min(rects[best].y0, rect.y0);
+    rects[best].x1 = (uint32_t)max(rects[best].x1, rect.x1);
+    rects[best].y1 = (uint32_t)max(rects[best].y1, rect.y1);
 }
 
-static inline void put_pixel(uint32_t x, uint32_t y, uint32_t xrgb)
+static size_t collect_damage(TerminalDisplay* display, DamageRect* rects)
 {
-    if (!_framebuffer_ok || x >= _framebuffer.width || y >= _framebuffer.height) 
+    size_t count = 0;
+
+    for (uint32_t ty = 0; ty < display->tile_rows; ty++)
     {
-        return;
+        uint32_t* row = &display->dirty_tiles[ty * display->tile_words_per_row];
+
+        uint32_t tx = 0;
+        while (tx < display->tile_columns)
+        {
+            if (!tile_dirty(row, tx))
+            {
+                tx++;
+                continue;
+            }
+
+            const uint32_t run_start = tx;
+            while (tx < display->tile_columns && tile_dirty(row, tx))
+            {
+                tx++;
+            }
+
+            add_damage_rect(rects, &count, (DamageRect){ run_start, ty, tx, ty + 1 });
+        }
+
+        for (uint32_t i = 0; i < display->tile_words_per_row; i++)
+        {
+            row[i] = 0;
+        }
     }
 
-    uint32_t stride_pixels = _framebuffer.stride_bytes / 4u;
-    _framebuffer.buffer[y * stride_pixels + x] = xrgb;
+    return count;
 }
 
 static void fill_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t xrgb)
 {
-    if (!_framebuffer_ok || x >= _framebuffer.width || y >= _framebuffer.height) 
+    if (!_display->ok || x >= _display->framebuffer.width || y >= _display->framebuffer.height) 
     {
         return;
     }
 
-    if (x + w > _framebuffer.width) 
+    if (x + w > _display->framebuffer.width) 
     {
-        w = _framebuffer.width - x;
+        w = _display->framebuffer.width - x;
     }
-    if (y + h > _framebuffer.height)
+    if (y + h > _display->framebuffer.height)
     {
-        h = _framebuffer.height - y;
+        h = _display->framebuffer.height - y;
     }
 
-    uint32_t stride_pixels = _framebuffer.stride_bytes / 4u;
+    begin_drawing(_display);
 
     for (uint32_t yy = 0; yy < h; yy++)
     {
-        uint32_t* row = &_framebuffer.buffer[(y + yy) * stride_pixels + x];
+        uint32_t* row = &_display->framebuffer.rows[y + yy][x];
 
         for (uint32_t xx = 0; xx < w; xx++)
         {
@@ -136,428 +353,1971 @@ static void fill_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t x
     mark_dirty_rect(x, y, w, h);
 }
 
-typedef struct 
-{ 
-    char ch; 
-    uint8_t rows[7];
-} Glyph5x7;
-
-static const Glyph5x7 _glyphs_5x7[] =
-{
-    // digits */
-    { '0', { 0x1E,0x21,0x23,0x25,0x29,0x31,0x1E } },
-    { '1', { 0x04,0x0C,0x04,0x04,0x04,0x04,0x0E } },
-    { '2', { 0x1E,0x21,0x01,0x06,0x18,0x20,0x3F } },
-    { '3', { 0x1E,0x21,0x01,0x0E,0x01,0x21,0x1E } },
-    { '4', { 0x02,0x06,0x0A,0x12,0x3F,0x02,0x02 } },
-    { '5', { 0x3F,0x20,0x3E,0x01,0x01,0x21,0x1E } },
-    { '6', { 0x0E,0x10,0x20,0x3E,0x21,0x21,0x1E } },
-    { '7', { 0x3F,0x01,0x02,0x04,0x08,0x10,0x10 } },
-    { '8', { 0x1E,0x21,0x21,0x1E,0x21,0x21,0x1E } },
-    { '9', { 0x1E,0x21,0x21,0x1F,0x01,0x02,0x1C } },
-
-    // uppercase letters
-    { 'A', { 0x0E,0x11,0x21,0x21,0x3F,0x21,0x21 } },
-    { 'B', { 0x3E,0x21,0x21,0x3E,0x21,0x21,0x3E } },
-    { 'C', { 0x1E,0x21,0x20,0x20,0x20,0x21,0x1E } },
-    { 'D', { 0x3C,0x22,0x21,0x21,0x21,0x22,0x3C } },
-    { 'E', { 0x3F,0x20,0x20,0x3E,0x20,0x20,0x3F } },
-    { 'F', { 0x3F,0x20,0x20,0x3E,0x20,0x20,0x20 } },
-    { 'G', { 0x1E,0x21,0x20,0x27,0x21,0x21,0x1E } },
-    { 'H', { 0x21,0x21,0x21,0x3F,0x21,0x21,0x21 } },
-    { 'I', { 0x0E,0x04,0x04,0x04,0x04,0x04,0x0E } },
-    { 'J', { 0x07,0x02,0x02,0x02,0x22,0x22,0x1C } },
-    { 'K', { 0x21,0x22,0x24,0x38,0x24,0x22,0x21 } },
-    { 'L', { 0x20,0x20,0x20,0x20,0x20,0x20,0x3F } },
-    { 'M', { 0x21,0x33,0x2D,0x21,0x21,0x21,0x21 } },
-    { 'N', { 0x21,0x31,0x29,0x25,0x23,0x21,0x21 } },
-    { 'O', { 0x1E,0x21,0x21,0x21,0x21,0x21,0x1E } },
-    { 'P', { 0x3E,0x21,0x21,0x3E,0x20,0x20,0x20 } },
-    { 'Q', { 0x1E,0x21,0x21,0x21,0x25,0x22,0x1D } },
-    { 'R', { 0x3E,0x21,0x21,0x3E,0x24,0x22,0x21 } },
-    { 'S', { 0x1F,0x20,0x20,0x1E,0x01,0x01,0x3E } },
-    { 'T', { 0x3F,0x04,0x04,0x04,0x04,0x04,0x04 } },
-    { 'U', { 0x21,0x21,0x21,0x21,0x21,0x21,0x1E } },
-    { 'V', { 0x21,0x21,0x21,0x21,0x21,0x12,0x0C } },
-    { 'W', { 0x21,0x21,0x21,0x21,0x2D,0x33,0x21 } },
-    { 'X', { 0x21,0x12,0x0C,0x0C,0x0C,0x12,0x21 } },
-    { 'Y', { 0x21,0x12,0x0C,0x04,0x04,0x04,0x04 } },
-    { 'Z', { 0x3F,0x01,0x02,0x04,0x08,0x10,0x3F } },
-
-    // lowercase letters (6x7, shifted-left variants of common 5x7 shapes)
-    { 'a', { 0x00,0x00,0x1C,0x02,0x1E,0x22,0x1E } },
-    { 'b', { 0x20,0x20,0x3C,0x22,0x22,0x22,0x3C } },
-    { 'c', { 0x00,0x00,0x1C,0x20,0x20,0x20,0x1C } },
-    { 'd', { 0x02,0x02,0x1E,0x22,0x22,0x22,0x1E } },
-    { 'e', { 0x00,0x00,0x1C,0x22,0x3E,0x20,0x1C } },
-    { 'f', { 0x0C,0x10,0x3C,0x10,0x10,0x10,0x10 } },
-    { 'g', { 0x00,0x00,0x1E,0x22,0x1E,0x02,0x1C } },
-    { 'h', { 0x20,0x20,0x3C,0x22,0x22,0x22,0x22 } },
-    { 'i', { 0x08,0x00,0x18,0x08,0x08,0x08,0x1C } },
-    { 'j', { 0x04,0x00,0x0C,0x04,0x04,0x24,0x18 } },
-    { 'k', { 0x20,0x24,0x28,0x30,0x28,0x24,0x22 } },
-    { 'l', { 0x18,0x08,0x08,0x08,0x08,0x08,0x1C } },
-    { 'm', { 0x00,0x00,0x34,0x2A,0x2A,0x2A,0x2A } },
-    { 'n', { 0x00,0x00,0x3C,0x22,0x22,0x22,0x22 } },
-    { 'o', { 0x00,0x00,0x1C,0x22,0x22,0x22,0x1C } },
-    { 'p', { 0x00,0x00,0x3C,0x22,0x3C,0x20,0x20 } },
-    { 'q', { 0x00,0x00,0x1E,0x22,0x1E,0x02,0x02 } },
-    { 'r', { 0x00,0x00,0x2C,0x30,0x20,0x20,0x20 } },
-    { 's', { 0x00,0x00,0x1E,0x20,0x1C,0x02,0x3C } },
-    { 't', { 0x10,0x3C,0x10,0x10,0x10,0x10,0x0C } },
-    { 'u', { 0x00,0x00,0x22,0x22,0x22,0x26,0x1A } },
-    { 'v', { 0x00,0x00,0x22,0x22,0x14,0x14,0x08 } },
-    { 'w', { 0x00,0x00,0x22,0x2A,0x2A,0x2A,0x14 } },
-    { 'x', { 0x00,0x00,0x22,0x14,0x08,0x14,0x22 } },
-    { 'y', { 0x00,0x00,0x22,0x22,0x1E,0x02,0x1C } },
-    { 'z', { 0x00,0x00,0x3E,0x04,0x08,0x10,0x3E } },
-
-    // symbols
-    { '-', { 0x00,0x00,0x00,0x1F,0x00,0x00,0x00 } },
-    { '.', { 0x00,0x00,0x00,0x00,0x00,0x0C,0x0C } },
-    { '!', { 0x04,0x04,0x04,0x04,0x04,0x00,0x04 } },
-    { ':', { 0x00,0x0C,0x0C,0x00,0x0C,0x0C,0x00 } },
-    { ';', { 0x00,0x18,0x18,0x00,0x18,0x18,0x10 } },
-    { '(', { 0x02,0x04,0x08,0x08,0x08,0x04,0x02 } },
-    { ')', { 0x08,0x04,0x02,0x02,0x02,0x04,0x08 } },
-    { '/', { 0x01,0x02,0x04,0x08,0x10,0x20,0x00 } },
-    { '\\',{ 0x20,0x10,0x08,0x04,0x02,0x00,0x00 } },
-    { ',', { 0x00,0x00,0x00,0x00,0x0C,0x0C,0x08 } },
-    { '\'',{ 0x04,0x04,0x02,0x00,0x00,0x00,0x00 } },
-    { '"',{ 0x0A,0x0A,0x04,0x00,0x00,0x00,0x00 } },
-    { '?', { 0x1E,0x21,0x01,0x06,0x04,0x00,0x04 } },
-    { '<', { 0x04,0x08,0x10,0x20,0x10,0x08,0x04 } },
-    { '>', { 0x10,0x08,0x04,0x02,0x04,0x08,0x10 } },
-    { '[', { 0x3C,0x20,0x20,0x20,0x20,0x20,0x3C } },
-    { ']', { 0x3C,0x04,0x04,0x04,0x04,0x04,0x3C } },
-    { '{', { 0x1C,0x10,0x10,0x20,0x10,0x10,0x1C } },
-    { '}', { 0x38,0x08,0x08,0x04,0x08,0x08,0x38 } },
-    { '+', { 0x00,0x08,0x08,0x3E,0x08,0x08,0x00 } },
-    { '=', { 0x00,0x00,0x3E,0x00,0x3E,0x00,0x00 } },
-    { '_', { 0x00,0x00,0x00,0x00,0x00,0x00,0x3E } },
-    { '@', { 0x1C,0x22,0x2E,0x2A,0x2E,0x20,0x1C } },
-    { '#', { 0x14,0x3E,0x14,0x14,0x3E,0x14,0x00 } },
-    { '$', { 0x08,0x1E,0x28,0x1C,0x0A,0x3C,0x08 } },
-    { '%', { 0x32,0x32,0x04,0x08,0x10,0x26,0x26 } },
-    { '&', { 0x18,0x24,0x28,0x10,0x2A,0x24,0x1A } },
-    { '*', { 0x00,0x14,0x08,0x3E,0x08,0x14,0x00 } },
-    { '|', { 0x08,0x08,0x08,0x08,0x08,0x08,0x08 } },
-    { ' ', { 0x00,0x00,0x00,0x00,0x00,0x00,0x00 } },
-};
+// Glyph rows are read MSB-first into the top of a word, so pixel i of any
+// row is bit 31 - i whatever the font width.
+#define GLYPH_ROW_1(g) ((uint32_t)(g)[0] << 24)
+#define GLYPH_ROW_2(g) (((uint32_t)(g)[0] << 24) | ((uint32_t)(g)[1] << 16))
+
+#define GLYPH_PIXEL(i) row[i] = (bits & (0x80000000u >> (i))) ? foreground : background;
+#define GLYPH_PIXELS_8 \
+    GLYPH_PIXEL(0) GLYPH_PIXEL(1) GLYPH_PIXEL(2) GLYPH_PIXEL(3) \
+    GLYPH_PIXEL(4) GLYPH_PIXEL(5) GLYPH_PIXEL(6) GLYPH_PIXEL(7)
+#define GLYPH_PIXELS_12 GLYPH_PIXELS_8 \
+    GLYPH_PIXEL(8) GLYPH_PIXEL(9) GLYPH_PIXEL(10) GLYPH_PIXEL(11)
+#define GLYPH_PIXELS_16 GLYPH_PIXELS_12 \
+    GLYPH_PIXEL(12) GLYPH_PIXEL(13) GLYPH_PIXEL(14) GLYPH_PIXEL(15)
+
+#define GLYPH_ROW(r, w, b) \
+    { \
+        uint32_t* row = &rows[r][pixel_x]; \
+        const uint32_t bits = GLYPH_ROW_##b(&glyph[(r) * (b)]); \
+        GLYPH_PIXELS_##w \
+    }
+#define GLYPH_ROWS_8(w, b) \
+    GLYPH_ROW(0, w, b) GLYPH_ROW(1, w, b) GLYPH_ROW(2, w, b) GLYPH_ROW(3, w, b) \
+    GLYPH_ROW(4, w, b) GLYPH_ROW(5, w, b) GLYPH_ROW(6, w, b) GLYPH_ROW(7, w, b)
+#define GLYPH_ROWS_16(w, b) GLYPH_ROWS_8(w, b) \
+    GLYPH_ROW(8, w, b) GLYPH_ROW(9, w, b) GLYPH_ROW(10, w, b) GLYPH_ROW(11, w, b) \
+    GLYPH_ROW(12, w, b) GLYPH_ROW(13, w, b) GLYPH_ROW(14, w, b) GLYPH_ROW(15, w, b)
+#define GLYPH_ROWS_24(w, b) GLYPH_ROWS_16(w, b) \
+    GLYPH_ROW(16, w, b) GLYPH_ROW(17, w, b) GLYPH_ROW(18, w, b) GLYPH_ROW(19, w, b) \
+    GLYPH_ROW(20, w, b) GLYPH_ROW(21, w, b) GLYPH_ROW(22, w, b) GLYPH_ROW(23, w, b)
+#define GLYPH_ROWS_32(w, b) GLYPH_ROWS_24(w, b) \
+    GLYPH_ROW(24, w, b) GLYPH_ROW(25, w, b) GLYPH_ROW(26, w, b) GLYPH_ROW(27, w, b) \
+    GLYPH_ROW(28, w, b) GLYPH_ROW(29, w, b) GLYPH_ROW(30, w, b) GLYPH_ROW(31, w, b)
+
+// One blitter per built-in cell size, with the width and height baked in:
+// every row and every pixel in it is written straight-line, so no loop or
+// size check runs per glyph.
+#define DEFINE_GLYPH_BLITTER(w, h, row_bytes) \
+    static void blit_glyph_##w##x##h(const uint8_t* glyph, uint32_t* const* rows, uint32_t pixel_x, \
+                                     uint32_t foreground, uint32_t background) \
+    { \
+        GLYPH_ROWS_##h(w, row_bytes) \
+    }
+
+DEFINE_GLYPH_BLITTER(8, 8, 1)
+DEFINE_GLYPH_BLITTER(8, 16, 1)
+DEFINE_GLYPH_BLITTER(12, 24, 2)
+DEFINE_GLYPH_BLITTER(16, 32, 2)
 
-static bool get_5x7(char c, uint8_t out_rows[7])
+static const struct
 {
-    const size_t glyph_count = sizeof(_glyphs_5x7) / sizeof(_glyphs_5x7[0]);
+    uint32_t width;
+    uint32_t height;
+    GlyphBlitter blit;
+} _glyph_blitters[] =
+{
+    { 8, 8, blit_glyph_8x8 },
+    { 8, 16, blit_glyph_8x16 },
+    { 12, 24, blit_glyph_12x24 },
+    { 16, 32, blit_glyph_16x32 },
+};
 
-    // Prefer exact-case lookups so lowercase can render distinctly.
-    for (size_t i = 0; i < glyph_count; i++)
+static GlyphBlitter glyph_blitter_for(const Font* font)
+{
+    for (size_t i = 0; i < sizeof(_glyph_blitters) / sizeof(_glyph_blitters[0]); i++)
     {
-        if (_glyphs_5x7[i].ch == c)
+        if (_glyph_blitters[i].width == font->width && _glyph_blitters[i].height == font->height)
         {
-            for (size_t j = 0; j < 7; j++)
-            {
-                out_rows[j] = _glyphs_5x7[i].rows[j];
-            }
-
-            return true;
+            return _glyph_blitters[i].blit;
         }
     }
 
-    // Backward-compatible fallback: if lowercase not present, use uppercase.
-    if (c >= 'a' && c <= 'z')
+    return 0;
+}
+
+// any font size and any clip, one pixel at a time; used for loaded fonts
+// without a specialized blitter and for cells hanging off the screen edge
+static void blit_glyph_generic(const uint8_t* glyph, uint32_t pixel_x, uint32_t pixel_y, uint32_t w, uint32_t h,
+                               uint32_t foreground, uint32_t background)
+{
+    const Font* font = _display->font;
+
+    for (uint32_t r = 0; r < h; r++, glyph += font->row_bytes)
     {
-        char upper = (char)(c - 'a' + 'A');
-        for (size_t i = 0; i < glyph_count; i++)
+        uint32_t* row = &_display->framebuffer.rows[pixel_y + r][pixel_x];
+
+        uint32_t bits = 0;
+        for (uint32_t b = 0; b < font->row_bytes; b++)
         {
-            if (_glyphs_5x7[i].ch == upper)
-            {
-                for (size_t j = 0; j < 7; j++)
-                {
-                    out_rows[j] = _glyphs_5x7[i].rows[j];
-                }
-                return true;
-            }
+            bits |= (uint32_t)glyph[b] << (24 - 8 * b);
         }
-    }
 
-    return false;
+        for (uint32_t col = 0; col < w; col++)
+        {
+            row[col] = (bits & (0x80000000u >> col)) ? foreground : background;
+        }
+    }
 }
 
-static void draw_box_char(uint8_t ch, uint32_t pixel_x, uint32_t pixel_y, uint32_t foreground, uint32_t background)
+// one clip check per glyph; cells wholly on screen take the specialized path
+static void blit_glyph(const uint8_t* glyph, uint32_t pixel_x, uint32_t pixel_y, uint32_t foreground, uint32_t background)
 {
-    fill_rect(pixel_x, pixel_y, GLYPH_W, GLYPH_H, background);
+    const FramebufferInfo* framebuffer = &_display->framebuffer;
+    const Font* font = _display->font;
 
-    const uint32_t x_midpoint = pixel_x + (GLYPH_W / 2);
-    const uint32_t y_midpoint = pixel_y + (GLYPH_H / 2);
+    if (pixel_x >= framebuffer->width || pixel_y >= framebuffer->height)
+    {
+        return;
+    }
 
-    const uint32_t x0 = pixel_x;
-    const uint32_t x1 = pixel_x + GLYPH_W - 1;
-    const uint32_t y0 = pixel_y;
-    const uint32_t y1 = pixel_y + GLYPH_H - 1;
+    const uint32_t w = (uint32_t)min(font->width, framebuffer->width - pixel_x);
+    const uint32_t h = (uint32_t)min(font->height, framebuffer->height - pixel_y);
 
-    switch (ch)
+    if (_display->blit && w == font->width && h == font->height)
     {
-        case 0xC4: // horizontal
-            for (uint32_t x = x0; x <= x1; x++)
-            {
-                put_pixel(x, y_midpoint, foreground);
-            }
-            break;
-        case 0xB3: // vertical
-            for (uint32_t y = y0; y <= y1; y++)
-            {
-                put_pixel(x_midpoint, y, foreground);
-            }
-            break;
-        case 0xDA: // top-left
-            for (uint32_t x = x_midpoint; x <= x1; x++)
-            {
-                put_pixel(x, y_midpoint, foreground);
-            }
-            for (uint32_t y = y_midpoint; y <= y1; y++)
-            {
-                put_pixel(x_midpoint, y, foreground);
-            }
-            break;
-        case 0xBF: // top-right
-            for (uint32_t x = x0; x <= x_midpoint; x++)
-            {
-                put_pixel(x, y_midpoint, foreground);
-            }
-            for (uint32_t y = y_midpoint; y <= y1; y++)
-            {
-                put_pixel(x_midpoint, y, foreground);
-            }
-            break;
-        case 0xC0: // bottom-left
-            for (uint32_t x = x_midpoint; x <= x1; x++)
-            {
-                put_pixel(x, y_midpoint, foreground);
-            }
-            for (uint32_t y = y0; y <= y_midpoint; y++)
-            {
-                put_pixel(x_midpoint, y, foreground);
-            }
-            break;
-        case 0xD9: // bottom-right
-            for (uint32_t x = x0; x <= x_midpoint; x++)
-            {
-                put_pixel(x, y_midpoint, foreground);
-            }
-            for (uint32_t y = y0; y <= y_midpoint; y++)
-            {
-                put_pixel(x_midpoint, y, foreground);
-            }
-            break;
-        default:
-            break;
+        _display->blit(glyph, &framebuffer->rows[pixel_y], pixel_x, foreground, background);
+    }
+    else
+    {
+        blit_glyph_generic(glyph, pixel_x, pixel_y, w, h, foreground, background);
     }
 
-    mark_dirty_rect(pixel_x, pixel_y, GLYPH_W, GLYPH_H);
+    mark_dirty_rect(pixel_x, pixel_y, w, h);
 }
 
-static void draw_glyph(char c, uint8_t color, uint32_t cell_x, uint32_t cell_y)
+// plain ASCII indexes the font directly; everything else goes through the
+// cache so a codepoint is only looked up and rendered once
+static inline const uint8_t* cell_glyph(const Font* font, uint32_t codepoint)
 {
-    const uint32_t foreground = fg_from_color(color);
-    const uint32_t background = bg_from_color(color);
+    return (codepoint < 0x80 && font->ascii_direct) ? font_glyph(font, codepoint) : glyph_cache_get(font, codepoint);
+}
+
+// Draws count adjacent cells of one row. Colors are resolved only when they
+// change, through the pair cache, the run is clipped once, glyphs go down
+// back to back and a single damage rect covers the lot.
+static void draw_cell_run(const Cell* cells, size_t count, uint32_t cell_x, uint32_t cell_y)
+{
+    const FramebufferInfo* framebuffer = &_display->framebuffer;
+    const Font* font = _display->font;
 
-    const uint32_t pixel_x = cell_x * GLYPH_W;
-    const uint32_t pixel_y = cell_y * GLYPH_H;
+    const uint32_t pixel_x = cell_x * font->width;
+    const uint32_t pixel_y = cell_y * font->height;
 
-    if (!_framebuffer_ok)
+    if (pixel_x >= framebuffer->width || pixel_y >= framebuffer->height)
     {
         return;
     }
 
-    if ((unsigned char)c >= 0x80)
+    // cells wholly on screen take the specialized blitter; any hanging off
+    // the right or bottom edge are clipped one by one
+    size_t whole = 0;
+    if (_display->blit && framebuffer->height - pixel_y >= font->height)
     {
-        draw_box_char((uint8_t)c, pixel_x, pixel_y, foreground, background);
-        return;
+        whole = min(count, (framebuffer->width - pixel_x) / font->width);
     }
 
-    fill_rect(pixel_x, pixel_y, GLYPH_W, GLYPH_H, background);
+    uint32_t* const* rows = &framebuffer->rows[pixel_y];
+    TerminalColor fg = cells[0].fg;
+    TerminalColor bg = cells[0].bg;
+    const ColorPair* pair = color_pair(fg, bg);
+    uint32_t foreground = pair->foreground;
+    uint32_t background = pair->background;
 
-    uint8_t rows[7];
-    if (!get_5x7(c, rows))
+    for (size_t i = 0; i < count; i++)
     {
-        (void)get_5x7('?', rows);
-    }
+        if (cells[i].fg != fg || cells[i].bg != bg)
+        {
+            fg = cells[i].fg;
+            bg = cells[i].bg;
+            pair = color_pair(fg, bg);
+            foreground = pair->foreground;
+            background = pair->background;
+        }
 
-    // glyph table uses 6-bit rows rendering as 6x7
-    // center 6x7 inside 8x16: x offset 1, y offset 4
-    const uint32_t x0 = pixel_x + 1;
-    const uint32_t y0 = pixel_y + 4;
+        const uint8_t* glyph = cell_glyph(font, cells[i].codepoint);
+        const uint32_t x = pixel_x + (uint32_t)i * font->width;
 
-    for (uint32_t r = 0; r < 7; r++)
-    {
-        uint8_t bits = rows[r];
-        for (uint32_t col = 0; col < 6; col++)
+        if (i < whole)
         {
-            if (bits & (1u << (5 - col)))
-            {
-                put_pixel(x0 + col, y0 + r, foreground);
-            }
+            _display->blit(glyph, rows, x, foreground, background);
+        }
+        else
+        {
+            blit_glyph(glyph, x, pixel_y, foreground, background);
         }
     }
 
-    mark_dirty_rect(pixel_x, pixel_y, GLYPH_W, GLYPH_H);
+    mark_dirty_rect(pixel_x, pixel_y, (uint32_t)whole * font->width, font->height);
 }
 
-void terminal_initialize(void)
+// the hardware cursor is one image shared by every head, so it is redrawn
+// whenever the caret lands on a display with a different cell size
+#define CARET_MAX_SIZE 64u
+
+// Blinking text caret. With a hardware cursor a blink is a show/hide on the
+// cursor queue and never touches the framebuffer. Without one the underline
+// is XORed into the cell's bottom rows and only that cell is presented.
+// Blinks are taken on frame ticks, so they share the frame's submission.
+typedef struct
 {
-    memory_init();
+    TerminalDisplay* display;
+    size_t x, y;
 
-    if (!virtio_gpu_init(&_framebuffer))
-    {
-        _framebuffer_ok = false;
-        return;
-    }
+    bool visible;
+    bool lit;
+    // software caret currently XORed into the display's framebuffer
+    bool drawn;
 
-    _framebuffer_ok = true;
-    _dirty = false;
+    uint32_t period;
+    uint32_t next_blink;
+} TerminalCaret;
 
-    _active_color = (uint8_t)((VGA_COLOR_LIGHT_GREY << 4) | VGA_COLOR_BLUE);
+static TerminalCaret _caret = { .period = PLATFORM_TIMER_HZ / 1000u * TERMINAL_CARET_BLINK_MS };
 
-    _columns = _framebuffer.width / GLYPH_W;
-    _rows = _framebuffer.height / GLYPH_H;
+static const Font* _caret_font;
 
-    if (_columns < 40) _columns = 40;
-    if (_rows < 15) _rows = 15;
+static void caret_define(const Font* font)
+{
+    // underline caret across the bottom two rows of the cell
+    static uint32_t image[CARET_MAX_SIZE * CARET_MAX_SIZE];
+
+    const uint32_t w = (uint32_t)min(font->width, CARET_MAX_SIZE);
+    const uint32_t h = (uint32_t)min(font->height, CARET_MAX_SIZE);
 
-    _cells = (Cell*)kmalloc_aligned(sizeof(Cell) * _columns * _rows, 16);
-    if (!_cells)
+    for (size_t i = 0; i < w * h; i++)
     {
-        printf("fb_console: cell alloc failed\n");
-        _framebuffer_ok = false;
-        return;
+        image[i] = (i >= w * (h - 2)) ? (0xFF000000u | xrgb_from_color(terminal_attribute_fg(_active_color))) : 0u;
     }
 
-    fill_rect(0, 0, _framebuffer.width, _framebuffer.height, bg_from_color(_active_color));
-
-    for (size_t y = 0; y < _rows; y++)
+    if (virtio_gpu_cursor_define(image, w, h, 0, 0))
     {
-        for (size_t x = 0; x < _columns; x++)
-        {
-            Cell* cell = cell_at(x, y);
-            cell->c = ' ';
-            cell->color = _active_color;
-        }
+        _caret_font = font;
     }
-
-    terminal_flush();
 }
 
-void terminal_putentryat(char c, uint8_t color, size_t x, size_t y)
+// pixel rectangle of the software caret, clipped to the framebuffer
+static bool caret_rect(const TerminalDisplay* display, FramebufferRect* out_rect)
 {
-    if (!_framebuffer_ok || x >= _columns || y >= _rows) 
+    if (!display->ok || _caret.x >= display->columns || _caret.y >= display->rows)
     {
-        return;
+        return false;
     }
 
-    Cell* cell = cell_at(x, y);
-    cell->c = c;
-    cell->color = color;
+    const Font* font = display->font;
+    const uint32_t x = (uint32_t)_caret.x * font->width;
+    const uint32_t y = (uint32_t)_caret.y * font->height + font->height - 2u;
+
+    if (x >= display->framebuffer.width || y >= display->framebuffer.height)
+    {
+        return false;
+    }
 
-    draw_glyph(c, color, (uint32_t)x, (uint32_t)y);
+    out_rect->x = x;
+    out_rect->y = y;
+    out_rect->width = (uint32_t)min(font->width, display->framebuffer.width - x);
+    out_rect->height = (uint32_t)min(2u, display->framebuffer.height - y);
+    return true;
 }
 
-void terminal_putchar(char c, size_t* x, size_t* y)
+static void caret_xor(TerminalDisplay* display)
 {
-    if (!x || !y) 
+    FramebufferRect rect;
+    if (!caret_rect(display, &rect))
     {
         return;
     }
 
-    switch (c)
+    begin_drawing(display);
+
+    for (uint32_t y = rect.y; y < rect.y + rect.height; y++)
     {
-        case '\n':
-            *x = 0;
-            (*y)++;
-            return;
-        case '\r':
-            *x = 0;
-            return;
-        case '\0':
-            return;
+        uint32_t* row = &display->framebuffer.rows[y][rect.x];
+        for (uint32_t x = 0; x < rect.width; x++)
+        {
+            row[x] ^= 0x00FFFFFFu;
+        }
     }
 
-    terminal_putentryat(c, _active_color, *x, *y);
+    _caret.drawn = !_caret.drawn;
+    display->caret_damage = true;
+    display->dirty = true;
+}
 
-    (*x)++;
+// Brings the software caret's pixels in line with its state. Called as the
+// frame goes out, after the display's cells have been drawn.
+static void caret_sync(TerminalDisplay* display)
+{
+    if (_caret.display != display || virtio_gpu_cursor_available())
+    {
+        return;
+    }
 
-    if ((*x) == _columns)
+    if (_caret.drawn != (_caret.visible && _caret.lit))
     {
-        *x = 0;
-        (*y)++;
-        if ((*y) == _rows)
-        {
-            *y = 0;
-        }
+        caret_xor(display);
     }
 }
 
-void terminal_write(const char* data, size_t size, size_t x, size_t y)
+// takes the software caret out of the framebuffer before its pixels are
+// overwritten or moved; the next frame puts it back
+static void caret_erase(TerminalDisplay* display)
 {
-    for (size_t i = 0; i < size; i++)
+    FramebufferRect rect;
+    if (_caret.display != display || !_caret.drawn || !caret_rect(display, &rect))
     {
-        terminal_putchar(data[i], &x, &y);
+        return;
     }
+
+    caret_xor(display);
+
+    // the caret may be about to move, so this spot goes out with the tiles
+    TerminalDisplay* selected = _display;
+    _display = display;
+    mark_dirty_rect(rect.x, rect.y, rect.width, rect.height);
+    _display = selected;
 }
 
-void terminal_writestring(const char* data, size_t x, size_t y)
+static void caret_restart_blink(void)
 {
-    terminal_write(data, strlen(data), x, y);
+    _caret.lit = true;
+    _caret.next_blink = (uint32_t)read_timestamp() + _caret.period;
 }
 
-bool terminal_getentryat(size_t x, size_t y, char* out_c, uint8_t* out_color)
+static void caret_blink(uint32_t now)
 {
-    if (!_framebuffer_ok || x >= _columns || y >= _rows)
+    if (!_caret.visible || !_caret.display || _caret.period == 0 || (int32_t)(now - _caret.next_blink) < 0)
     {
-        return false;
+        return;
     }
 
-    Cell* cell = cell_at(x, y);
-    if (out_c)
+    _caret.lit = !_caret.lit;
+    _caret.next_blink += _caret.period;
+    if ((int32_t)(now - _caret.next_blink) >= 0)
     {
-        *out_c = cell->c;
+        _caret.next_blink = now + _caret.period;
     }
-    if (out_color)
+
+    if (virtio_gpu_cursor_available())
     {
-        *out_color = cell->color;
+        virtio_gpu_cursor_show(_caret.lit);
+    }
+    else
+    {
+        _caret.display->dirty = true;
     }
-    return true;
 }
 
-void terminal_get_size(size_t* out_cols, size_t* out_rows)
+void terminal_set_caret(size_t x, size_t y)
 {
-    if (out_cols) 
+    if (!_display->ok || x >= _display->columns || y >= _display->rows)
     {
-        *out_cols = _columns;
+        return;
     }
-    if (out_rows)
+
+    if (_caret.display)
+    {
+        caret_erase(_caret.display);
+    }
+
+    _caret.display = _display;
+    _caret.x = x;
+    _caret.y = y;
+
+    // a caret that just moved is always shown; the blink starts over
+    const bool was_lit = _caret.lit;
+    caret_restart_blink();
+
+    if (virtio_gpu_cursor_available())
+    {
+        if (_caret_font != _display->font)
+        {
+            caret_define(_display->font);
+        }
+
+        virtio_gpu_cursor_move((uint32_t)(_display - _displays), (uint32_t)x * _display->font->width,
+                               (uint32_t)y * _display->font->height);
+
+        if (!was_lit)
+        {
+            virtio_gpu_cursor_show(_caret.visible);
+        }
+    }
+    else
     {
-        *out_rows = _rows;
+        _display->dirty = true;
     }
 }
 
-void terminal_flush(void)
+void terminal_show_caret(bool visible)
 {
-    if (!_framebuffer_ok || !_dirty)
+    if (!_display->ok)
     {
         return;
     }
 
-    uint32_t x0 = _dirty_x0;
-    uint32_t y0 = _dirty_y0;
-    uint32_t x1 = _dirty_x1;
-    uint32_t y1 = _dirty_y1;
+    _caret.visible = visible;
+    caret_restart_blink();
+
+    if (virtio_gpu_cursor_available())
+    {
+        virtio_gpu_cursor_show(visible);
+    }
+    else if (_caret.display)
+    {
+        _caret.display->dirty = true;
+    }
+}
 
-    _dirty = false;
+void terminal_set_caret_blink(uint32_t period_ms)
+{
+    _caret.period = PLATFORM_TIMER_HZ / 1000u * period_ms;
+    caret_restart_blink();
 
-    if (x1 <= x0 || y1 <= y0) 
+    if (virtio_gpu_cursor_available())
     {
-        return;
+        virtio_gpu_cursor_show(_caret.visible);
+    }
+    else if (_caret.display)
+    {
+        _caret.display->dirty = true;
     }
+}
+
+// (re)builds the selected display's cell grid and damage map for its current
+// framebuffer size; buffers are only reallocated when they need to grow
+static bool terminal_setup_geometry(void)
+{
+    _display->tile_columns = (_display->framebuffer.width + DAMAGE_TILE_W - 1) / DAMAGE_TILE_W;
+    _display->tile_rows = (_display->framebuffer.height + DAMAGE_TILE_H - 1) / DAMAGE_TILE_H;
+    _display->tile_words_per_row = (_display->tile_columns + 31u) / 32u;
 
-    virtio_gpu_flush_rect(x0, y0, x1 - x0, y1 - y0);
+    const size_t tile_words = _display->tile_words_per_row * _display->tile_rows;
+    if (tile_words > _display->dirty_tiles_capacity)
+    {
+        _display->dirty_tiles = (uint32_t*)kmalloc_aligned(sizeof(uint32_t) * tile_words, 4);
+        if (!_display->dirty_tiles)
+        {
+            printf("fb_console: damage map alloc failed\n");
+            return false;
+        }
+        _display->dirty_tiles_capacity = tile_words;
+    }
+    memset(_display->dirty_tiles, 0, sizeof(uint32_t) * tile_words);
+
+    _display->font = _display->font_choice ? _display->font_choice
+                                           : font_for_resolution(_display->framebuffer.width, _display->framebuffer.height);
+    _display->blit = glyph_blitter_for(_display->font);
+
+    _display->columns = _display->framebuffer.width / _display->font->width;
+    _display->rows = _display->framebuffer.height / _display->font->height;
+
+    if (_display->columns < 40) _display->columns = 40;
+    if (_display->rows < 15) _display->rows = 15;
+
+    _display->cell_words_per_row = (_display->columns + 31u) / 32u;
+
+    const size_t cell_words = _display->cell_words_per_row * _display->rows;
+    if (cell_words > _display->dirty_cells_capacity)
+    {
+        _display->dirty_cells = (uint32_t*)kmalloc_aligned(sizeof(uint32_t) * cell_words, 4);
+        if (!_display->dirty_cells)
+        {
+            printf("fb_console: dirty cell map alloc failed\n");
+            return false;
+        }
+        _display->dirty_cells_capacity = cell_words;
+    }
+    memset(_display->dirty_cells, 0, sizeof(uint32_t) * cell_words);
+
+    if (_display->columns * _display->rows > _display->cells_capacity)
+    {
+        _display->cells = (Cell*)kmalloc_aligned(sizeof(Cell) * _display->columns * _display->rows, 16);
+        if (!_display->cells)
+        {
+            printf("fb_console: cell alloc failed\n");
+            return false;
+        }
+        _display->cells_capacity = _display->columns * _display->rows;
+    }
+
+    for (size_t y = 0; y < _display->rows; y++)
+    {
+        for (size_t x = 0; x < _display->columns; x++)
+        {
+            Cell* cell = cell_at(x, y);
+            cell->codepoint = ' ';
+            cell->fg = terminal_attribute_fg(_active_color);
+            cell->bg = terminal_attribute_bg(_active_color);
+        }
+    }
+
+    _display->ok = true;
+    _display->dirty = false;
+
+    // the clear below wipes a software caret along with everything else
+    if (_caret.display == _display)
+    {
+        _caret.drawn = false;
+    }
+
+    fill_rect(0, 0, _display->framebuffer.width, _display->framebuffer.height, xrgb_from_color(terminal_attribute_bg(_active_color)));
+    return true;
+}
+
+// picks up the scanout's framebuffer and rebuilds the display around it; a
+// head that is disabled or fails to set up is simply left out
+static bool terminal_setup_display(size_t index)
+{
+    TerminalDisplay* selected = _display;
+    _display = &_displays[index];
+    _display->ok = false;
+
+    bool ok = virtio_gpu_get_scanout((uint32_t)index, &_display->framebuffer) && terminal_setup_geometry();
+    if (!ok)
+    {
+        _display->ok = false;
+    }
+
+    _display = selected;
+    return ok;
+}
+
+void terminal_initialize(void)
+{
+    memory_init();
+    palette_init();
+
+    if (!virtio_gpu_init())
+    {
+        return;
+    }
+
+    _active_color = (uint8_t)((VGA_COLOR_LIGHT_GREY << 4) | VGA_COLOR_BLUE);
+
+    _display_count = virtio_gpu_scanout_count();
+
+    for (size_t i = 0; i < _display_count; i++)
+    {
+        terminal_setup_display(i);
+    }
+
+    // start out on the first head that came up
+    for (size_t i = 0; i < _display_count; i++)
+    {
+        if (_displays[i].ok)
+        {
+            _display = &_displays[i];
+            break;
+        }
+    }
+
+    if (_display->ok && virtio_gpu_cursor_available())
+    {
+        caret_define(_display->font);
+    }
+
+    terminal_flush();
+}
+
+size_t terminal_display_count(void)
+{
+    return _display_count;
+}
+
+bool terminal_select_display(size_t display)
+{
+    if (display >= _display_count || !_displays[display].ok)
+    {
+        return false;
+    }
+
+    _display = &_displays[display];
+    return true;
+}
+
+size_t terminal_selected_display(void)
+{
+    return (size_t)(_display - _displays);
+}
+
+void terminal_set_resize_handler(TerminalResizeHandler handler)
+{
+    _resize_handler = handler;
+}
+
+bool terminal_set_font(const Font* font)
+{
+    if (!_display->ok)
+    {
+        return false;
+    }
+
+    const size_t index = terminal_selected_display();
+    _display->font_choice = font;
+
+    // the font may have been reloaded in place, so nothing cached from the
+    // old contents under this address can be trusted
+    if (font)
+    {
+        glyph_cache_flush(font);
+    }
+    _caret_font = 0;
+
+    // a new cell size is a new grid, same as a mode change
+    if (!terminal_setup_display(index))
+    {
+        return false;
+    }
+
+    if (_resize_handler)
+    {
+        _resize_handler(index, _display->columns, _display->rows);
+    }
+
+    return true;
+}
+
+const Font* terminal_get_font(void)
+{
+    return _display->font;
+}
+
+static void terminal_poll_resize(void)
+{
+    const uint32_t changed = virtio_gpu_poll_resize();
+    if (changed == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < _display_count; i++)
+    {
+        if ((changed & (1u << i)) == 0)
+        {
+            continue;
+        }
+
+        if (!terminal_setup_display(i))
+        {
+            printf("fb_console: display %u gone\n", (unsigned)i);
+            continue;
+        }
+
+        // the fresh grid is blank; the owner repaints it once and the next
+        // frame presents the whole thing in a single flip
+        if (_resize_handler)
+        {
+            TerminalDisplay* selected = _display;
+            _display = &_displays[i];
+            _resize_handler(i, _display->columns, _display->rows);
+            _display = selected;
+        }
+    }
+}
+
+// bytes above 0x7F on the char calls are code page 437, which is what the
+// box drawing in the UI has always used
+static inline uint32_t codepoint_from_char(char c)
+{
+    return ((unsigned char)c < 0x80) ? (unsigned char)c : font_cp437_to_unicode((uint8_t)c);
+}
+
+void terminal_putcodepointat(uint32_t codepoint, uint8_t color, size_t x, size_t y)
+{
+    if (!_display->ok || x >= _display->columns || y >= _display->rows) 
+    {
+        return;
+    }
+
+    const TerminalColor fg = terminal_attribute_fg(color);
+    const TerminalColor bg = terminal_attribute_bg(color);
+
+    Cell* cell = cell_at(x, y);
+    if (cell->codepoint == codepoint && cell->fg == fg && cell->bg == bg)
+    {
+        return;
+    }
+
+    cell->codepoint = codepoint;
+    cell->fg = fg;
+    cell->bg = bg;
+
+    _display->dirty_cells[y * _display->cell_words_per_row + x / 32u] |= 1u << (x % 32u);
+    _display->dirty = true;
+}
+
+void terminal_putentryat(char c, uint8_t color, size_t x, size_t y)
+{
+    terminal_putcodepointat(codepoint_from_char(c), color, x, y);
+}
+
+// Shared by the run calls: updates one cell of a row that has already been
+// clipped, and collects its dirty bit.
+static inline bool set_run_cell(Cell* cell, uint32_t codepoint, TerminalColor fg, TerminalColor bg)
+{
+    if (cell->codepoint == codepoint && cell->fg == fg && cell->bg == bg)
+    {
+        return false;
+    }
+
+    cell->codepoint = codepoint;
+    cell->fg = fg;
+    cell->bg = bg;
+    return true;
+}
+
+size_t terminal_write_run(size_t x, size_t y, uint8_t color, const char* data, size_t size)
+{
+    return terminal_write_run_color(x, y, terminal_attribute_fg(color), terminal_attribute_bg(color), data, size);
+}
+
+size_t terminal_fill_run(size_t x, size_t y, uint8_t color, uint32_t codepoint, size_t count)
+{
+    return terminal_fill_run_color(x, y, terminal_attribute_fg(color), terminal_attribute_bg(color), codepoint, count);
+}
+
+size_t terminal_write_run_color(size_t x, size_t y, TerminalColor fg, TerminalColor bg, const char* data, size_t size)
+{
+    if (!_display->ok || !data || y >= _display->rows || x >= _display->columns)
+    {
+        return 0;
+    }
+
+    const size_t columns = _display->columns - x;
+    Cell* cells = cell_at(x, y);
+    uint32_t* dirty = &_display->dirty_cells[y * _display->cell_words_per_row];
+
+    size_t count = 0;
+    size_t i = 0;
+    while (i < size && count < columns)
+    {
+        uint32_t codepoint = (unsigned char)data[i];
+        if (codepoint < 0x80)
+        {
+            i++;
+        }
+        else
+        {
+            i += utf8_next(&data[i], size - i, &codepoint);
+        }
+
+        if (set_run_cell(&cells[count], codepoint, fg, bg))
+        {
+            dirty[(x + count) / 32u] |= 1u << ((x + count) % 32u);
+            _display->dirty = true;
+        }
+
+        count++;
+    }
+
+    return count;
+}
+
+size_t terminal_fill_run_color(size_t x, size_t y, TerminalColor fg, TerminalColor bg, uint32_t codepoint, size_t count)
+{
+    if (!_display->ok || y >= _display->rows || x >= _display->columns)
+    {
+        return 0;
+    }
+
+    count = min(count, _display->columns - x);
+    Cell* cells = cell_at(x, y);
+    uint32_t* dirty = &_display->dirty_cells[y * _display->cell_words_per_row];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (set_run_cell(&cells[i], codepoint, fg, bg))
+        {
+            dirty[(x + i) / 32u] |= 1u << ((x + i) % 32u);
+            _display->dirty = true;
+        }
+    }
+
+    return count;
+}
+
+size_t terminal_put_cells(size_t x, size_t y, const TerminalCell* cells, size_t count)
+{
+    if (!_display->ok || !cells || y >= _display->rows || x >= _display->columns)
+    {
+        return 0;
+    }
+
+    count = min(count, _display->columns - x);
+    Cell* row = cell_at(x, y);
+    uint32_t* dirty = &_display->dirty_cells[y * _display->cell_words_per_row];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (set_run_cell(&row[i], cells[i].codepoint, cells[i].fg, cells[i].bg))
+        {
+            dirty[(x + i) / 32u] |= 1u << ((x + i) % 32u);
+            _display->dirty = true;
+        }
+    }
+
+    return count;
+}
+
+static void put_codepoint(uint32_t codepoint, size_t* x, size_t* y)
+{
+    switch (codepoint)
+    {
+        case '\n':
+            *x = 0;
+            (*y)++;
+            return;
+        case '\r':
+            *x = 0;
+            return;
+        case '\0':
+            return;
+    }
+
+    terminal_putcodepointat(codepoint, _active_color, *x, *y);
+
+    (*x)++;
+
+    if ((*x) == _display->columns)
+    {
+        *x = 0;
+        (*y)++;
+        if ((*y) == _display->rows)
+        {
+            *y = 0;
+        }
+    }
+}
+
+void terminal_putchar(char c, size_t* x, size_t* y)
+{
+    if (!x || !y) 
+    {
+        return;
+    }
+
+    put_codepoint(codepoint_from_char(c), x, y);
+}
+
+// kept across calls, so a sequence split between two writes still decodes
+static Utf8Decoder _write_decoder;
+
+void terminal_write(const char* data, size_t size, size_t x, size_t y)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        uint32_t codepoint = 0;
+        const Utf8Status status = utf8_decode(&_write_decoder, (uint8_t)data[i], &codepoint);
+
+        // a cut-short sequence leaves its byte to start the next one
+        if (status != UTF8_RETRY)
+        {
+            i++;
+        }
+
+        if (status != UTF8_PENDING)
+        {
+            put_codepoint(codepoint, &x, &y);
+        }
+    }
+}
+
+void terminal_writestring(const char* data, size_t x, size_t y)
+{
+    terminal_write(data, strlen(data), x, y);
+}
+
+bool terminal_getentryat(size_t x, size_t y, char* out_c, uint8_t* out_color)
+{
+    if (!_display->ok || x >= _display->columns || y >= _display->rows)
+    {
+        return false;
+    }
+
+    Cell* cell = cell_at(x, y);
+    if (out_c)
+    {
+        *out_c = (cell->codepoint < 0x80) ? (char)cell->codepoint : (char)font_unicode_to_cp437(cell->codepoint);
+    }
+    if (out_color)
+    {
+        *out_color = (uint8_t)((vga_from_color(cell->bg) << 4) | vga_from_color(cell->fg));
+    }
+    return true;
+}
+
+// draws every cell marked since the last flush, which in turn marks the
+// damage tiles the present is built from
+static void rasterize_dirty_cells(TerminalDisplay* display)
+{
+    TerminalDisplay* selected = _display;
+    _display = display;
+
+    begin_drawing(display);
+
+    // redrawing the caret's cell wipes the software caret; caret_sync puts
+    // it back when the frame goes out
+    if (_caret.display == display && _caret.drawn && _caret.x < display->columns && _caret.y < display->rows &&
+        (display->dirty_cells[_caret.y * display->cell_words_per_row + _caret.x / 32u] >> (_caret.x % 32u)) & 1u)
+    {
+        _caret.drawn = false;
+    }
+
+    for (size_t y = 0; y < display->rows; y++)
+    {
+        uint32_t* words = &display->dirty_cells[y * display->cell_words_per_row];
+
+        for (size_t w = 0; w < display->cell_words_per_row; w++)
+        {
+            uint32_t bits = words[w];
+            words[w] = 0;
+
+            // each stretch of adjacent dirty cells is drawn as one run
+            while (bits)
+            {
+                const uint32_t start = (uint32_t)__builtin_ctz(bits);
+                const uint32_t rest = ~(bits >> start);
+                const uint32_t run = rest ? (uint32_t)__builtin_ctz(rest) : 32u - start;
+
+                bits = (run == 32u) ? 0u : (bits & ~(((1u << run) - 1u) << start));
+
+                const size_t x = w * 32u + start;
+                draw_cell_run(cell_at(x, y), run, (uint32_t)x, (uint32_t)y);
+            }
+        }
+    }
+
+    _display = selected;
+}
+
+static void scroll_region(Rect rect, int32_t lines, TerminalColor fill_fg, TerminalColor fill_bg)
+{
+    if (!_display->ok || lines == 0 || rect.pos.x >= _display->columns || rect.pos.y >= _display->rows)
+    {
+        return;
+    }
+
+    const size_t left = rect.pos.x;
+    const size_t top = rect.pos.y;
+    const size_t width = min(rect.size.x, _display->columns - left);
+    const size_t height = min(rect.size.y, _display->rows - top);
+
+    if (width == 0 || height == 0)
+    {
+        return;
+    }
+
+    const bool up = lines > 0;
+    const size_t shift = min(up ? (size_t)lines : (size_t)-lines, height);
+    const size_t kept = height - shift;
+
+    // pending cells are drawn first so the pixels being moved are current,
+    // and the caret is lifted so it does not travel with them
+    rasterize_dirty_cells(_display);
+    caret_erase(_display);
+
+    for (size_t i = 0; i < kept; i++)
+    {
+        const size_t y = up ? (top + i) : (top + height - 1 - i);
+        const size_t from = up ? (y + shift) : (y - shift);
+        memmove(cell_at(left, y), cell_at(left, from), sizeof(Cell) * width);
+    }
+
+    const size_t exposed_top = up ? (top + kept) : top;
+    for (size_t y = exposed_top; y < exposed_top + shift; y++)
+    {
+        for (size_t x = left; x < left + width; x++)
+        {
+            Cell* cell = cell_at(x, y);
+            cell->codepoint = ' ';
+            cell->fg = fill_fg;
+            cell->bg = fill_bg;
+        }
+    }
+
+    // the same move in pixels, clipped to what is actually on screen
+    const FramebufferInfo* framebuffer = &_display->framebuffer;
+    const uint32_t glyph_w = _display->font->width;
+    const uint32_t glyph_h = _display->font->height;
+    const uint32_t pixel_left = (uint32_t)left * glyph_w;
+    const uint32_t pixel_top = (uint32_t)top * glyph_h;
+
+    if (pixel_left >= framebuffer->width || pixel_top >= framebuffer->height)
+    {
+        return;
+    }
+
+    const uint32_t pixel_width = (uint32_t)min(width * glyph_w, framebuffer->width - pixel_left);
+    const uint32_t pixel_height = (uint32_t)min(height * glyph_h, framebuffer->height - pixel_top);
+    const uint32_t pixel_shift = (uint32_t)min(shift * glyph_h, pixel_height);
+    const uint32_t pixel_kept = pixel_height - pixel_shift;
+
+    for (uint32_t i = 0; i < pixel_kept; i++)
+    {
+        const uint32_t y = up ? (pixel_top + i) : (pixel_top + pixel_height - 1 - i);
+        const uint32_t from = up ? (y + pixel_shift) : (y - pixel_shift);
+        memmove(&framebuffer->rows[y][pixel_left], &framebuffer->rows[from][pixel_left], pixel_width * 4u);
+    }
+
+    fill_rect(pixel_left, up ? (pixel_top + pixel_kept) : pixel_top, pixel_width, pixel_shift, xrgb_from_color(fill_bg));
+    mark_dirty_rect(pixel_left, pixel_top, pixel_width, pixel_height);
+}
+
+void terminal_scroll_region(Rect rect, int32_t lines, uint8_t fill_color)
+{
+    scroll_region(rect, lines, terminal_attribute_fg(fill_color), terminal_attribute_bg(fill_color));
+}
+
+void terminal_get_size(size_t* out_cols, size_t* out_rows)
+{
+    if (out_cols) 
+    {
+        *out_cols = _display->columns;
+    }
+    if (out_rows)
+    {
+        *out_rows = _display->rows;
+    }
+}
+
+// VT100 / ECMA-48 output stream. Bytes are classified once through a table
+// and every (state, class) pair maps to an action and the next state, which
+// keeps the per-byte work to two lookups. Printable runs in the ground state
+// skip the machine entirely and are written straight into the cell grid.
+
+#define VT_MAX_PARAMS 16u
+#define VT_MAX_PARAM_VALUE 9999u
+
+typedef enum
+{
+    VT_GROUND,
+    VT_ESCAPE,
+    VT_ESCAPE_INTER,
+    VT_CSI_PARAM,
+    VT_CSI_INTER,
+    VT_CSI_IGNORE,
+    VT_STATE_COUNT,
+} VtState;
+
+// everything from VT_CLASS_PRINT on is printable in the ground state
+typedef enum
+{
+    VT_CLASS_CONTROL,
+    VT_CLASS_ESC,
+    VT_CLASS_CANCEL,
+    VT_CLASS_DEL,
+    VT_CLASS_PRINT,
+    VT_CLASS_INTER,
+    VT_CLASS_DIGIT,
+    VT_CLASS_SEP,
+    VT_CLASS_PRIVATE,
+    VT_CLASS_BRACKET,
+    VT_CLASS_FINAL,
+    VT_CLASS_COUNT,
+} VtClass;
+
+typedef enum
+{
+    VT_NONE,
+    VT_PRINT,
+    VT_EXECUTE,
+    VT_CLEAR,
+    VT_PARAM,
+    VT_COLLECT,
+    VT_ESC_DISPATCH,
+    VT_CSI_DISPATCH,
+} VtAction;
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+#endif
+
+static const uint8_t _vt_classes[256] =
+{
+    [0x00 ... 0x1f] = VT_CLASS_CONTROL,
+    [0x18]          = VT_CLASS_CANCEL,
+    [0x1a]          = VT_CLASS_CANCEL,
+    [0x1b]          = VT_CLASS_ESC,
+    [0x20 ... 0x2f] = VT_CLASS_INTER,
+    [0x30 ... 0x39] = VT_CLASS_DIGIT,
+    [0x3a ... 0x3b] = VT_CLASS_SEP,
+    [0x3c ... 0x3f] = VT_CLASS_PRIVATE,
+    [0x40 ... 0x7e] = VT_CLASS_FINAL,
+    ['[']           = VT_CLASS_BRACKET,
+    [0x7f]          = VT_CLASS_DEL,
+    [0x80 ... 0xff] = VT_CLASS_PRINT,
+};
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#define VT(action, state) (uint8_t)(((action) << 4) | (state))
+#define VT_ACTION(entry) ((VtAction)((entry) >> 4))
+#define VT_NEXT(entry) ((VtState)((entry) & 0x0Fu))
+
+static const uint8_t _vt_transitions[VT_STATE_COUNT][VT_CLASS_COUNT] =
+{
+    [VT_GROUND] =
+    {
+        [VT_CLASS_CONTROL] = VT(VT_EXECUTE, VT_GROUND),
+        [VT_CLASS_ESC]     = VT(VT_CLEAR, VT_ESCAPE),
+        [VT_CLASS_CANCEL]  = VT(VT_NONE, VT_GROUND),
+        [VT_CLASS_DEL]     = VT(VT_NONE, VT_GROUND),
+        [VT_CLASS_PRINT]   = VT(VT_PRINT, VT_GROUND),
+        [VT_CLASS_INTER]   = VT(VT_PRINT, VT_GROUND),
+        [VT_CLASS_DIGIT]   = VT(VT_PRINT, VT_GROUND),
+        [VT_CLASS_SEP]     = VT(VT_PRINT, VT_GROUND),
+        [VT_CLASS_PRIVATE] = VT(VT_PRINT, VT_GROUND),
+        [VT_CLASS_BRACKET] = VT(VT_PRINT, VT_GROUND),
+        [VT_CLASS_FINAL]   = VT(VT_PRINT, VT_GROUND),
+    },
+    [VT_ESCAPE] =
+    {
+        [VT_CLASS_CONTROL] = VT(VT_EXECUTE, VT_ESCAPE),
+        [VT_CLASS_ESC]     = VT(VT_CLEAR, VT_ESCAPE),
+        [VT_CLASS_CANCEL]  = VT(VT_NONE, VT_GROUND),
+        [VT_CLASS_DEL]     = VT(VT_NONE, VT_ESCAPE),
+        [VT_CLASS_PRINT]   = VT(VT_NONE, VT_GROUND),
+        [VT_CLASS_INTER]   = VT(VT_COLLECT, VT_ESCAPE_INTER),
+        [VT_CLASS_DIGIT]   = VT(VT_ESC_DISPATCH, VT_GROUND),
+        [VT_CLASS_SEP]     = VT(VT_ESC_DISPATCH, VT_GROUND),
+        [VT_CLASS_PRIVATE] = VT(VT_ESC_DISPATCH, VT_GROUND),
+        [VT_CLASS_BRACKET] = VT(VT_CLEAR, VT_CSI_PARAM),
+        [VT_CLASS_FINAL]   = VT(VT_ESC_DISPATCH, VT_GROUND),
+    },
+    [VT_ESCAPE_INTER] =
+    {
+        [VT_CLASS_CONTROL] = VT(VT_EXECUTE, VT_ESCAPE_INTER),
+        [VT_CLASS_ESC]     = VT(VT_CLEAR, VT_ESCAPE),
+        [VT_CLASS_CANCEL]  = VT(VT_NONE, VT_GROUND),
+        [VT_CLASS_DEL]     = VT(VT_NONE, VT_ESCAPE_INTER),
+        [VT_CLASS_PRINT]   = VT(VT_NONE, VT_GROUND),
+        [VT_CLASS_INTER]   = VT(VT_COLLECT, VT_ESCAPE_INTER),
+        [VT_CLASS_DIGIT]   = VT(VT_ESC_DISPATCH, VT_GROUND),
+        [VT_CLASS_SEP]     = VT(VT_ESC_DISPATCH, VT_GROUND),
+        [VT_CLASS_PRIVATE] = VT(VT_ESC_DISPATCH, VT_GROUND),
+        [VT_CLASS_BRACKET] = VT(VT_ESC_DISPATCH, VT_GROUND),
+        [VT_CLASS_FINAL]   = VT(VT_ESC_DISPATCH, VT_GROUND),
+    },
+    [VT_CSI_PARAM] =
+    {
+        [VT_CLASS_CONTROL] = VT(VT_EXECUTE, VT_CSI_PARAM),
+        [VT_CLASS_ESC]     = VT(VT_CLEAR, VT_ESCAPE),
+        [VT_CLASS_CANCEL]  = VT(VT_NONE, VT_GROUND),
+        [VT_CLASS_DEL]     = VT(VT_NONE, VT_CSI_PARAM),
+        [VT_CLASS_PRINT]   = VT(VT_NONE, VT_CSI_IGNORE),
+        [VT_CLASS_INTER]   = VT(VT_COLLECT, VT_CSI_INTER),
+        [VT_CLASS_DIGIT]   = VT(VT_PARAM, VT_CSI_PARAM),
+        [VT_CLASS_SEP]     = VT(VT_PARAM, VT_CSI_PARAM),
+        [VT_CLASS_PRIVATE] = VT(VT_COLLECT, VT_CSI_PARAM),
+        [VT_CLASS_BRACKET] = VT(VT_CSI_DISPATCH, VT_GROUND),
+        [VT_CLASS_FINAL]   = VT(VT_CSI_DISPATCH, VT_GROUND),
+    },
+    [VT_CSI_INTER] =
+    {
+        [VT_CLASS_CONTROL] = VT(VT_EXECUTE, VT_CSI_INTER),
+        [VT_CLASS_ESC]     = VT(VT_CLEAR, VT_ESCAPE),
+        [VT_CLASS_CANCEL]  = VT(VT_NONE, VT_GROUND),
+        [VT_CLASS_DEL]     = VT(VT_NONE, VT_CSI_INTER),
+        [VT_CLASS_PRINT]   = VT(VT_NONE, VT_CSI_IGNORE),
+        [VT_CLASS_INTER]   = VT(VT_COLLECT, VT_CSI_INTER),
+        [VT_CLASS_DIGIT]   = VT(VT_NONE, VT_CSI_IGNORE),
+        [VT_CLASS_SEP]     = VT(VT_NONE, VT_CSI_IGNORE),
+        [VT_CLASS_PRIVATE] = VT(VT_NONE, VT_CSI_IGNORE),
+        [VT_CLASS_BRACKET] = VT(VT_CSI_DISPATCH, VT_GROUND),
+        [VT_CLASS_FINAL]   = VT(VT_CSI_DISPATCH, VT_GROUND),
+    },
+    [VT_CSI_IGNORE] =
+    {
+        [VT_CLASS_CONTROL] = VT(VT_EXECUTE, VT_CSI_IGNORE),
+        [VT_CLASS_ESC]     = VT(VT_CLEAR, VT_ESCAPE),
+        [VT_CLASS_CANCEL]  = VT(VT_NONE, VT_GROUND),
+        [VT_CLASS_DEL]     = VT(VT_NONE, VT_CSI_IGNORE),
+        [VT_CLASS_PRINT]   = VT(VT_NONE, VT_CSI_IGNORE),
+        [VT_CLASS_INTER]   = VT(VT_NONE, VT_CSI_IGNORE),
+        [VT_CLASS_DIGIT]   = VT(VT_NONE, VT_CSI_IGNORE),
+        [VT_CLASS_SEP]     = VT(VT_NONE, VT_CSI_IGNORE),
+        [VT_CLASS_PRIVATE] = VT(VT_NONE, VT_CSI_IGNORE),
+        [VT_CLASS_BRACKET] = VT(VT_NONE, VT_GROUND),
+        [VT_CLASS_FINAL]   = VT(VT_NONE, VT_GROUND),
+    },
+};
+
+// ANSI color order (black, red, green, yellow, ...) to VGA palette indices
+static const uint8_t _ansi_to_vga[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+typedef struct
+{
+    size_t x, y;
+    TerminalColor fg, bg;
+    bool bold, reverse;
+} VtCursor;
+
+typedef struct
+{
+    VtState state;
+
+    // cell rectangle the stream draws into; the cursor is relative to it
+    Rect window;
+    uint8_t default_color;
+
+    VtCursor cursor;
+    VtCursor saved;
+    bool wrap_pending;
+
+    // scrolling region rows, inclusive and relative to the window
+    size_t scroll_top;
+    size_t scroll_bottom;
+
+    uint32_t params[VT_MAX_PARAMS];
+    size_t param_count;
+    char marker;
+
+    // printable bytes above 0x7F are UTF-8, possibly split across writes
+    Utf8Decoder utf8;
+} TerminalStream;
+
+static TerminalStream _stream;
+
+static inline bool vt_printable(char c)
+{
+    return _vt_classes[(unsigned char)c] >= VT_CLASS_PRINT;
+}
+
+// bold brightens only the eight basic colors, as xterm does
+static void stream_colors(TerminalColor* out_fg, TerminalColor* out_bg)
+{
+    const VtCursor* cursor = &_stream.cursor;
+
+    TerminalColor fg = (cursor->bold && cursor->fg < 8u) ? (cursor->fg | 0x08u) : cursor->fg;
+    TerminalColor bg = cursor->bg;
+
+    *out_fg = cursor->reverse ? bg : fg;
+    *out_bg = cursor->reverse ? fg : bg;
+}
+
+static void stream_erase(size_t row, size_t from, size_t to)
+{
+    if (from < to)
+    {
+        TerminalColor fg, bg;
+        stream_colors(&fg, &bg);
+        terminal_fill_run_color(_stream.window.pos.x + from, _stream.window.pos.y + row, fg, bg, ' ', to - from);
+    }
+}
+
+static void stream_scroll(int32_t lines)
+{
+    const Rect region = RECT(POINT(_stream.window.pos.x, _stream.window.pos.y + _stream.scroll_top),
+                             POINT(_stream.window.size.x, _stream.scroll_bottom - _stream.scroll_top + 1));
+    TerminalColor fg, bg;
+    stream_colors(&fg, &bg);
+    scroll_region(region, lines, fg, bg);
+}
+
+static void stream_index(void)
+{
+    if (_stream.cursor.y == _stream.scroll_bottom)
+    {
+        stream_scroll(1);
+    }
+    else if (_stream.cursor.y + 1 < _stream.window.size.y)
+    {
+        _stream.cursor.y++;
+    }
+}
+
+static void stream_reverse_index(void)
+{
+    if (_stream.cursor.y == _stream.scroll_top)
+    {
+        stream_scroll(-1);
+    }
+    else if (_stream.cursor.y > 0)
+    {
+        _stream.cursor.y--;
+    }
+}
+
+static void stream_move_to(size_t x, size_t y)
+{
+    _stream.cursor.x = min(x, _stream.window.size.x - 1);
+    _stream.cursor.y = min(y, _stream.window.size.y - 1);
+    _stream.wrap_pending = false;
+}
+
+static void stream_reset(void)
+{
+    _stream.cursor.fg = terminal_attribute_fg(_stream.default_color);
+    _stream.cursor.bg = terminal_attribute_bg(_stream.default_color);
+    _stream.cursor.bold = false;
+    _stream.cursor.reverse = false;
+    _stream.saved = _stream.cursor;
+    _stream.scroll_top = 0;
+    _stream.scroll_bottom = _stream.window.size.y - 1;
+    _stream.state = VT_GROUND;
+    _stream.utf8.remaining = 0;
+    stream_move_to(0, 0);
+}
+
+// a character printed on the last column wraps the line only once the next
+// one arrives
+static void stream_wrap(void)
+{
+    if (_stream.wrap_pending)
+    {
+        _stream.cursor.x = 0;
+        _stream.wrap_pending = false;
+        stream_index();
+    }
+}
+
+static void stream_advance(size_t count)
+{
+    _stream.cursor.x += count;
+
+    // the cursor parks on the last column until something else is printed
+    if (_stream.cursor.x == _stream.window.size.x)
+    {
+        _stream.cursor.x--;
+        _stream.wrap_pending = true;
+    }
+}
+
+// ASCII run
+static void stream_print(const char* data, size_t size)
+{
+    TerminalColor fg, bg;
+    stream_colors(&fg, &bg);
+
+    while (size > 0)
+    {
+        stream_wrap();
+
+        const size_t count = min(size, _stream.window.size.x - _stream.cursor.x);
+        terminal_write_run_color(_stream.window.pos.x + _stream.cursor.x, _stream.window.pos.y + _stream.cursor.y, fg, bg, data, count);
+
+        data += count;
+        size -= count;
+        stream_advance(count);
+    }
+}
+
+static void stream_print_codepoint(uint32_t codepoint)
+{
+    TerminalColor fg, bg;
+    stream_colors(&fg, &bg);
+
+    stream_wrap();
+    terminal_fill_run_color(_stream.window.pos.x + _stream.cursor.x, _stream.window.pos.y + _stream.cursor.y, fg, bg,
+                            codepoint, 1);
+    stream_advance(1);
+}
+
+static void stream_print_utf8(const char* data, size_t size)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        uint32_t codepoint = 0;
+        const Utf8Status status = utf8_decode(&_stream.utf8, (uint8_t)data[i], &codepoint);
+
+        if (status != UTF8_RETRY)
+        {
+            i++;
+        }
+
+        if (status != UTF8_PENDING)
+        {
+            stream_print_codepoint(codepoint);
+        }
+    }
+}
+
+static void stream_execute(char c)
+{
+    switch (c)
+    {
+        case '\b':
+            if (_stream.cursor.x > 0)
+            {
+                _stream.cursor.x--;
+            }
+            _stream.wrap_pending = false;
+            break;
+        case '\t':
+            stream_move_to((_stream.cursor.x + 8u) & ~(size_t)7u, _stream.cursor.y);
+            break;
+        // LF also returns the carriage, as the serial console does
+        case '\n':
+        case '\v':
+        case '\f':
+            _stream.cursor.x = 0;
+            _stream.wrap_pending = false;
+            stream_index();
+            break;
+        case '\r':
+            _stream.cursor.x = 0;
+            _stream.wrap_pending = false;
+            break;
+        default:
+            break;
+    }
+}
+
+static uint32_t stream_param(size_t index, uint32_t fallback)
+{
+    return (index < _stream.param_count && _stream.params[index] != 0) ? _stream.params[index] : fallback;
+}
+
+static void stream_param_byte(char c)
+{
+    if (_stream.param_count == 0)
+    {
+        _stream.param_count = 1;
+        _stream.params[0] = 0;
+    }
+
+    if (c == ';' || c == ':')
+    {
+        if (_stream.param_count < VT_MAX_PARAMS)
+        {
+            _stream.params[_stream.param_count++] = 0;
+        }
+        return;
+    }
+
+    uint32_t* param = &_stream.params[_stream.param_count - 1];
+    *param = (uint32_t)min(*param * 10u + (uint32_t)(c - '0'), VT_MAX_PARAM_VALUE);
+}
+
+// Arguments of an extended color at params[*index]: "5;n" picks from the
+// 256-color palette and "2;r;g;b" is 24-bit. Moves *index to the last
+// argument used; a malformed one takes the rest of the sequence with it.
+static bool stream_sgr_color(size_t* index, TerminalColor* out_color)
+{
+    const uint32_t* args = &_stream.params[*index + 1];
+    const size_t available = _stream.param_count - (*index + 1);
+
+    if (available >= 2 && args[0] == 5)
+    {
+        const uint32_t n = (uint32_t)min(args[1], 255u);
+
+        // the palette keeps the first sixteen in VGA rather than ANSI order
+        *out_color = (n < 16u) ? (TerminalColor)(_ansi_to_vga[n & 7u] | (n & 8u)) : n;
+        *index += 2;
+        return true;
+    }
+
+    if (available >= 4 && args[0] == 2)
+    {
+        *out_color = TERMINAL_RGB(min(args[1], 255u), min(args[2], 255u), min(args[3], 255u));
+        *index += 4;
+        return true;
+    }
+
+    *index = _stream.param_count;
+    return false;
+}
+
+static void stream_sgr(void)
+{
+    VtCursor* cursor = &_stream.cursor;
+
+    if (_stream.param_count == 0)
+    {
+        _stream.param_count = 1;
+        _stream.params[0] = 0;
+    }
+
+    for (size_t i = 0; i < _stream.param_count; i++)
+    {
+        const uint32_t p = _stream.params[i];
+
+        if (p == 0)
+        {
+            cursor->fg = terminal_attribute_fg(_stream.default_color);
+            cursor->bg = terminal_attribute_bg(_stream.default_color);
+            cursor->bold = false;
+            cursor->reverse = false;
+        }
+        else if (p == 1)
+        {
+            cursor->bold = true;
+        }
+        else if (p == 22)
+        {
+            cursor->bold = false;
+        }
+        else if (p == 7)
+        {
+            cursor->reverse = true;
+        }
+        else if (p == 27)
+        {
+            cursor->reverse = false;
+        }
+        else if (p >= 30 && p <= 37)
+        {
+            cursor->fg = _ansi_to_vga[p - 30];
+        }
+        else if (p == 39)
+        {
+            cursor->fg = terminal_attribute_fg(_stream.default_color);
+        }
+        else if (p >= 40 && p <= 47)
+        {
+            cursor->bg = _ansi_to_vga[p - 40];
+        }
+        else if (p == 49)
+        {
+            cursor->bg = terminal_attribute_bg(_stream.default_color);
+        }
+        else if (p >= 90 && p <= 97)
+        {
+            cursor->fg = _ansi_to_vga[p - 90] | 0x08u;
+        }
+        else if (p >= 100 && p <= 107)
+        {
+            cursor->bg = _ansi_to_vga[p - 100] | 0x08u;
+        }
+        else if (p == 38 || p == 48)
+        {
+            TerminalColor color;
+            if (stream_sgr_color(&i, &color))
+            {
+                if (p == 38)
+                {
+                    cursor->fg = color;
+                }
+                else
+                {
+                    cursor->bg = color;
+                }
+            }
+        }
+    }
+}
+
+static void stream_csi_dispatch(char final)
+{
+    const size_t width = _stream.window.size.x;
+    const size_t height = _stream.window.size.y;
+    const VtCursor* cursor = &_stream.cursor;
+
+    // private sequences (ESC [ ? ...) are not implemented
+    if (_stream.marker != 0)
+    {
+        return;
+    }
+
+    switch (final)
+    {
+        case 'm':
+            stream_sgr();
+            break;
+        case 'H':
+        case 'f':
+            stream_move_to(stream_param(1, 1) - 1, stream_param(0, 1) - 1);
+            break;
+        case 'A':
+            stream_move_to(cursor->x, cursor->y - min(stream_param(0, 1), cursor->y));
+            break;
+        case 'B':
+            stream_move_to(cursor->x, cursor->y + stream_param(0, 1));
+            break;
+        case 'C':
+            stream_move_to(cursor->x + stream_param(0, 1), cursor->y);
+            break;
+        case 'D':
+            stream_move_to(cursor->x - min(stream_param(0, 1), cursor->x), cursor->y);
+            break;
+        case 'G':
+            stream_move_to(stream_param(0, 1) - 1, cursor->y);
+            break;
+        case 'd':
+            stream_move_to(cursor->x, stream_param(0, 1) - 1);
+            break;
+        case 'J':
+        {
+            const uint32_t mode = stream_param(0, 0);
+            if (mode == 0)
+            {
+                stream_erase(cursor->y, cursor->x, width);
+                for (size_t y = cursor->y + 1; y < height; y++)
+                {
+                    stream_erase(y, 0, width);
+                }
+            }
+            else if (mode == 1)
+            {
+                for (size_t y = 0; y < cursor->y; y++)
+                {
+                    stream_erase(y, 0, width);
+                }
+                stream_erase(cursor->y, 0, cursor->x + 1);
+            }
+            else if (mode == 2)
+            {
+                for (size_t y = 0; y < height; y++)
+                {
+                    stream_erase(y, 0, width);
+                }
+            }
+        } break;
+        case 'K':
+        {
+            const uint32_t mode = stream_param(0, 0);
+            if (mode == 0)
+            {
+                stream_erase(cursor->y, cursor->x, width);
+            }
+            else if (mode == 1)
+            {
+                stream_erase(cursor->y, 0, cursor->x + 1);
+            }
+            else if (mode == 2)
+            {
+                stream_erase(cursor->y, 0, width);
+            }
+        } break;
+        case 'r':
+        {
+            const size_t top = stream_param(0, 1) - 1;
+            const size_t bottom = min(stream_param(1, (uint32_t)height), height) - 1;
+            if (top < bottom)
+            {
+                _stream.scroll_top = top;
+                _stream.scroll_bottom = bottom;
+                stream_move_to(0, 0);
+            }
+        } break;
+        case 's':
+            _stream.saved = _stream.cursor;
+            break;
+        case 'u':
+            _stream.cursor = _stream.saved;
+            stream_move_to(_stream.cursor.x, _stream.cursor.y);
+            break;
+        default:
+            break;
+    }
+}
+
+static void stream_esc_dispatch(char final)
+{
+    if (_stream.marker != 0)
+    {
+        return;
+    }
+
+    switch (final)
+    {
+        case '7':
+            _stream.saved = _stream.cursor;
+            break;
+        case '8':
+            _stream.cursor = _stream.saved;
+            stream_move_to(_stream.cursor.x, _stream.cursor.y);
+            break;
+        case 'D':
+            stream_index();
+            break;
+        case 'E':
+            _stream.cursor.x = 0;
+            stream_index();
+            break;
+        case 'M':
+            stream_reverse_index();
+            break;
+        case 'c':
+            stream_reset();
+            for (size_t y = 0; y < _stream.window.size.y; y++)
+            {
+                stream_erase(y, 0, _stream.window.size.x);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void terminal_stream_set_window(Rect window, uint8_t color)
+{
+    if (!_display->ok || window.pos.x >= _display->columns || window.pos.y >= _display->rows)
+    {
+        return;
+    }
+
+    window.size.x = min(window.size.x, _display->columns - window.pos.x);
+    window.size.y = min(window.size.y, _display->rows - window.pos.y);
+
+    if (window.size.x == 0 || window.size.y == 0)
+    {
+        return;
+    }
+
+    _stream.window = window;
+    _stream.default_color = color;
+    stream_reset();
+}
+
+void terminal_stream_write(const char* data, size_t size)
+{
+    if (!_display->ok || _stream.window.size.x == 0)
+    {
+        return;
+    }
+
+    size_t i = 0;
+    while (i < size)
+    {
+        // plain text fast path: a whole printable run goes down in one write,
+        // and only runs with bytes above 0x7F go through the UTF-8 decoder
+        if (_stream.state == VT_GROUND && vt_printable(data[i]))
+        {
+            uint8_t high = (uint8_t)data[i];
+            size_t end = i + 1;
+            while (end < size && vt_printable(data[end]))
+            {
+                high |= (uint8_t)data[end];
+                end++;
+            }
+
+            if ((high & 0x80u) == 0 && _stream.utf8.remaining == 0)
+            {
+                stream_print(&data[i], end - i);
+            }
+            else
+            {
+                stream_print_utf8(&data[i], end - i);
+            }
+
+            i = end;
+            continue;
+        }
+
+        // a control or escape byte cuts off any sequence in progress
+        if (_stream.utf8.remaining != 0)
+        {
+            _stream.utf8.remaining = 0;
+            stream_print_codepoint(UTF8_REPLACEMENT);
+        }
+
+        const char c = data[i++];
+        const uint8_t entry = _vt_transitions[_stream.state][_vt_classes[(unsigned char)c]];
+
+        switch (VT_ACTION(entry))
+        {
+            case VT_PRINT:
+                stream_print(&c, 1);
+                break;
+            case VT_EXECUTE:
+                stream_execute(c);
+                break;
+            case VT_CLEAR:
+                _stream.param_count = 0;
+                _stream.marker = 0;
+                break;
+            case VT_PARAM:
+                stream_param_byte(c);
+                break;
+            case VT_COLLECT:
+                _stream.marker = c;
+                break;
+            case VT_ESC_DISPATCH:
+                stream_esc_dispatch(c);
+                break;
+            case VT_CSI_DISPATCH:
+                stream_csi_dispatch(c);
+                break;
+            case VT_NONE:
+            default:
+                break;
+        }
+
+        _stream.state = VT_NEXT(entry);
+    }
+}
+
+void terminal_stream_writestring(const char* data)
+{
+    terminal_stream_write(data, strlen(data));
+}
+
+void terminal_stream_get_cursor(size_t* out_x, size_t* out_y)
+{
+    if (out_x)
+    {
+        *out_x = _stream.window.pos.x + _stream.cursor.x;
+    }
+    if (out_y)
+    {
+        *out_y = _stream.window.pos.y + _stream.cursor.y;
+    }
+}
+
+// Adds the caret's rect to a display's damage unless a tile rect already
+// covers it. Returns whether any extra pixels are sent.
+static bool add_caret_damage(FramebufferRect* damage, size_t* count, FramebufferRect caret)
+{
+    for (size_t i = 0; i < *count; i++)
+    {
+        if (caret.x >= damage[i].x && caret.y >= damage[i].y &&
+            caret.x + caret.width <= damage[i].x + damage[i].width &&
+            caret.y + caret.height <= damage[i].y + damage[i].height)
+        {
+            return false;
+        }
+    }
+
+    if (*count < DAMAGE_MAX_RECTS)
+    {
+        damage[(*count)++] = caret;
+        return true;
+    }
+
+    // out of rects: stretch the last one over the caret
+    FramebufferRect* last = &damage[*count - 1];
+    const uint32_t x1 = (uint32_t)max(last->x + last->width, caret.x + caret.width);
+    const uint32_t y1 = (uint32_t)max(last->y + last->height, caret.y + caret.height);
+    last->x = (uint32_t)min(last->x, caret.x);
+    last->y = (uint32_t)min(last->y, caret.y);
+    last->width = x1 - last->x;
+    last->height = y1 - last->y;
+    return true;
+}
+
+static bool terminal_any_dirty(void)
+{
+    for (size_t i = 0; i < _display_count; i++)
+    {
+        if (_displays[i].ok && _displays[i].dirty)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void terminal_flush(void)
+{
+    static FramebufferRect damage[VIRTIO_GPU_MAX_SCANOUTS][DAMAGE_MAX_RECTS];
+    FramebufferPresent presents[VIRTIO_GPU_MAX_SCANOUTS];
+    size_t present_count = 0;
+
+    uint32_t rect_count = 0;
+    uint32_t bytes = 0;
+
+    // every dirty head goes into the same present so the device sees a
+    // single submission per frame no matter how many displays changed
+    for (size_t d = 0; d < _display_count; d++)
+    {
+        TerminalDisplay* display = &_displays[d];
+        if (!display->ok || !display->dirty)
+        {
+            continue;
+        }
+
+        rasterize_dirty_cells(display);
+        caret_sync(display);
+        display->dirty = false;
+
+        DamageRect rects[DAMAGE_MAX_RECTS];
+        size_t count = collect_damage(display, rects);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint32_t x0 = rects[i].x0 * DAMAGE_TILE_W;
+            const uint32_t y0 = rects[i].y0 * DAMAGE_TILE_H;
+            const uint32_t x1 = (uint32_t)min(rects[i].x1 * DAMAGE_TILE_W, display->framebuffer.width);
+            const uint32_t y1 = (uint32_t)min(rects[i].y1 * DAMAGE_TILE_H, display->framebuffer.height);
+
+            damage[present_count][i] = (FramebufferRect){ x0, y0, x1 - x0, y1 - y0 };
+            bytes += (x1 - x0) * (y1 - y0) * 4u;
+        }
+
+        // the caret goes out as its own small rect rather than a whole tile
+        FramebufferRect caret;
+        if (display->caret_damage && caret_rect(display, &caret) && add_caret_damage(damage[present_count], &count, caret))
+        {
+            bytes += caret.width * caret.height * 4u;
+        }
+        display->caret_damage = false;
+
+        if (count == 0)
+        {
+            continue;
+        }
+
+        // rendering continues into the buffer handed back by the flip
+        presents[present_count] = (FramebufferPresent){ (uint32_t)d, damage[present_count], count, &display->framebuffer };
+        present_count++;
+        rect_count += (uint32_t)count;
+    }
+
+    if (present_count == 0)
+    {
+        return;
+    }
+
+    virtio_gpu_present(presents, present_count);
+
+    _flush_stats.flushes++;
+    _flush_stats.rects += rect_count;
+    _flush_stats.last_rects = rect_count;
+    _flush_stats.last_bytes = bytes;
+    _flush_stats.total_bytes += bytes;
+}
+
+void terminal_set_refresh_rate(uint32_t hz)
+{
+    _frame_period = (hz == 0) ? 0 : PLATFORM_TIMER_HZ / hz;
+    _next_frame = (uint32_t)read_timestamp();
+}
+
+uint32_t terminal_next_frame(void)
+{
+    return _next_frame;
+}
+
+void terminal_frame_tick(void)
+{
+    if (_display_count == 0)
+    {
+        return;
+    }
+
+    const uint32_t now = (uint32_t)read_timestamp();
+    if ((int32_t)(now - _next_frame) < 0)
+    {
+        return;
+    }
+
+    // stay on the frame grid, but never try to catch up on missed frames
+    _next_frame += _frame_period;
+    if ((int32_t)(now - _next_frame) >= 0)
+    {
+        _next_frame = now + _frame_period;
+    }
+
+    terminal_poll_resize();
+    caret_blink(now);
+
+    if (!terminal_any_dirty())
+    {
+        // unthrottled, every tick would count as a skipped frame
+        if (_frame_period != 0)
+        {
+            _flush_stats.frames_skipped++;
+        }
+        return;
+    }
+
+    terminal_flush();
+    _flush_stats.frames_presented++;
+}
+
+void terminal_get_flush_stats(TerminalFlushStats* out_stats)
+{
+    if (out_stats)
+    {
+        *out_stats = _flush_stats;
+    }
 }
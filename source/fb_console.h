@@ -5,13 +5,126 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "defs.h"
+#include "font.h"
+
+typedef struct
+{
+    uint32_t flushes;
+    uint32_t rects;
+    uint32_t last_rects;
+    uint32_t last_bytes;
+    uint64_t total_bytes;
+
+    uint32_t frames_presented;
+    // frame slots that came up with nothing to draw; not counted at a
+    // refresh rate of 0, where there are no slots
+    uint32_t frames_skipped;
+} TerminalFlushStats;
+
+#define TERMINAL_DEFAULT_REFRESH_HZ 60u
+
+typedef void (*TerminalResizeHandler)(size_t display, size_t columns, size_t rows);
+
+// Cell color beyond the attribute byte. Values below 256 index the palette:
+// 0-15 are the VGA colors in attribute order, 16-231 the xterm 6x6x6 cube
+// and 232-255 its grey ramp. TERMINAL_RGB builds a 24-bit color.
+typedef uint32_t TerminalColor;
+#define TERMINAL_COLOR_RGB 0x01000000u
+#define TERMINAL_RGB(r, g, b) ((TerminalColor)(TERMINAL_COLOR_RGB | ((uint32_t)(r) << 16) | ((uint32_t)(g) << 8) | (uint32_t)(b)))
+
+// the attribute byte the char calls take: background high, foreground low
+static inline TerminalColor terminal_attribute_fg(uint8_t color)
+{
+    return color & 0x0Fu;
+}
+
+static inline TerminalColor terminal_attribute_bg(uint8_t color)
+{
+    return (color >> 4) & 0x0Fu;
+}
+
+typedef struct
+{
+    uint32_t codepoint;
+    TerminalColor fg;
+    TerminalColor bg;
+} TerminalCell;
+
 void terminal_initialize(void);
+
+// One console per display head, indexed by scanout id. Drawing, sizing and
+// the caret all apply to the selected display; flushing covers every one.
+size_t terminal_display_count(void);
+bool terminal_select_display(size_t display);
+size_t terminal_selected_display(void);
+
+// Cell font for the selected display; null goes back to picking one by
+// resolution. The grid is rebuilt blank and the resize handler runs. A Font
+// reloaded in place must be passed in again so its cached glyphs are dropped.
+bool terminal_set_font(const Font* font);
+const Font* terminal_get_font(void);
+
+// The char calls take code page 437 above 0x7F, the encoding the UI's box
+// drawing uses; terminal_write and the stream decode UTF-8.
+void terminal_putcodepointat(uint32_t codepoint, uint8_t color, size_t x, size_t y);
 void terminal_putentryat(char c, uint8_t color, size_t x, size_t y);
 void terminal_putchar(char c, size_t* x, size_t* y);
 void terminal_write(const char* data, size_t size, size_t x, size_t y);
 void terminal_writestring(const char* data, size_t x, size_t y);
+// Writes a run of cells on one row in one color, clipped once to the grid;
+// data is UTF-8 and the return value is how many cells were written. The
+// fill variant repeats a single codepoint.
+size_t terminal_write_run(size_t x, size_t y, uint8_t color, const char* data, size_t size);
+size_t terminal_fill_run(size_t x, size_t y, uint8_t color, uint32_t codepoint, size_t count);
+// The same with separate foreground and background colors.
+size_t terminal_write_run_color(size_t x, size_t y, TerminalColor fg, TerminalColor bg, const char* data, size_t size);
+size_t terminal_fill_run_color(size_t x, size_t y, TerminalColor fg, TerminalColor bg, uint32_t codepoint, size_t count);
+// Copies prepared cells onto one row; only those that differ are redrawn.
+// This is how off-screen cell surfaces are composited onto the screen.
+size_t terminal_put_cells(size_t x, size_t y, const TerminalCell* cells, size_t count);
+
 void terminal_get_size(size_t* out_cols, size_t* out_rows);
+// cells drawn with extended colors read back as the nearest attribute colors
 bool terminal_getentryat(size_t x, size_t y, char* out_c, uint8_t* out_color);
+
+// Scrolls the cells inside rect (position and size in cells) by lines rows;
+// positive moves content up. Pixels are moved in bulk and only the exposed
+// rows are cleared to fill_color.
+void terminal_scroll_region(Rect rect, int32_t lines, uint8_t fill_color);
+
+// VT100/ECMA-48 output confined to a window of cells: SGR colors (16, 256
+// and 24-bit), cursor addressing (CUP, CUU/CUD/CUF/CUB, CHA, VPA), ED, EL,
+// DECSTBM scroll regions and cursor save/restore. LF also returns the
+// carriage, matching the serial console, so the same byte stream can drive
+// both.
+void terminal_stream_set_window(Rect window, uint8_t color);
+void terminal_stream_write(const char* data, size_t size);
+void terminal_stream_writestring(const char* data);
+void terminal_stream_get_cursor(size_t* out_x, size_t* out_y);
+
+// Blinking underline caret. It uses the GPU's hardware cursor when there is
+// one; otherwise it is XORed into the cell and each blink presents just that
+// cell. Moving the caret restarts the blink; a period of 0 holds it steady.
+#define TERMINAL_CARET_BLINK_MS 530u
+
+void terminal_set_caret(size_t x, size_t y);
+void terminal_show_caret(bool visible);
+void terminal_set_caret_blink(uint32_t period_ms);
+// Presents pending damage immediately; meant for latency-critical paths.
+// Everything else should leave damage to the frame tick.
 void terminal_flush(void);
 
+// Call continuously from the main loop. Presents at most once per refresh
+// period and only if something changed; a rate of 0 presents on every tick.
+void terminal_frame_tick(void);
+void terminal_set_refresh_rate(uint32_t hz);
+// Timestamp of the next frame tick that can do any work.
+uint32_t terminal_next_frame(void);
+
+// Called from the frame tick after a display changed size, with that display
+// selected; its grid has been rebuilt blank and should be repainted.
+void terminal_set_resize_handler(TerminalResizeHandler handler);
+void terminal_get_flush_stats(TerminalFlushStats* out_stats);
+
 #endif
@@ -0,0 +1,781 @@
+// Stratus: font.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include "font.h"
+
+#include "utf8.h"
+#include "utility.h"
+
+#define PSF2_MAGIC 0x864ab572u
+#define PSF2_HEADER_SIZE 32u
+#define PSF2_HAS_UNICODE_TABLE 0x01u
+#define PSF2_SEPARATOR 0xFFu
+#define PSF2_START_SEQUENCE 0xFEu
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t flags;
+    uint32_t length;
+    uint32_t glyph_size;
+    uint32_t height;
+    uint32_t width;
+} Psf2Header;
+
+#define PSF2_HEADER(w, h, row_bytes) \
+    { PSF2_MAGIC, 0u, PSF2_HEADER_SIZE, 0u, 256u, (h) * (row_bytes), (h), (w) }
+
+// The built-in fonts are generated from one set of 6x7 shapes, scaled to each
+// cell size by the macros below. Every glyph starts out as '?' and the known
+// shapes override it.
+#define FONT_UNKNOWN(X) \
+    X(0 ... 255, 0x1E, 0x21, 0x01, 0x06, 0x04, 0x00, 0x04)
+
+#define FONT_SHAPES(X) \
+    /* digits */ \
+    X('0', 0x1E, 0x21, 0x23, 0x25, 0x29, 0x31, 0x1E) \
+    X('1', 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E) \
+    X('2', 0x1E, 0x21, 0x01, 0x06, 0x18, 0x20, 0x3F) \
+    X('3', 0x1E, 0x21, 0x01, 0x0E, 0x01, 0x21, 0x1E) \
+    X('4', 0x02, 0x06, 0x0A, 0x12, 0x3F, 0x02, 0x02) \
+    X('5', 0x3F, 0x20, 0x3E, 0x01, 0x01, 0x21, 0x1E) \
+    X('6', 0x0E, 0x10, 0x20, 0x3E, 0x21, 0x21, 0x1E) \
+    X('7', 0x3F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x10) \
+    X('8', 0x1E, 0x21, 0x21, 0x1E, 0x21, 0x21, 0x1E) \
+    X('9', 0x1E, 0x21, 0x21, 0x1F, 0x01, 0x02, 0x1C) \
+    /* uppercase letters */ \
+    X('A', 0x0E, 0x11, 0x21, 0x21, 0x3F, 0x21, 0x21) \
+    X('B', 0x3E, 0x21, 0x21, 0x3E, 0x21, 0x21, 0x3E) \
+    X('C', 0x1E, 0x21, 0x20, 0x20, 0x20, 0x21, 0x1E) \
+    X('D', 0x3C, 0x22, 0x21, 0x21, 0x21, 0x22, 0x3C) \
+    X('E', 0x3F, 0x20, 0x20, 0x3E, 0x20, 0x20, 0x3F) \
+    X('F', 0x3F, 0x20, 0x20, 0x3E, 0x20, 0x20, 0x20) \
+    X('G', 0x1E, 0x21, 0x20, 0x27, 0x21, 0x21, 0x1E) \
+    X('H', 0x21, 0x21, 0x21, 0x3F, 0x21, 0x21, 0x21) \
+    X('I', 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E) \
+    X('J', 0x07, 0x02, 0x02, 0x02, 0x22, 0x22, 0x1C) \
+    X('K', 0x21, 0x22, 0x24, 0x38, 0x24, 0x22, 0x21) \
+    X('L', 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x3F) \
+    X('M', 0x21, 0x33, 0x2D, 0x21, 0x21, 0x21, 0x21) \
+    X('N', 0x21, 0x31, 0x29, 0x25, 0x23, 0x21, 0x21) \
+    X('O', 0x1E, 0x21, 0x21, 0x21, 0x21, 0x21, 0x1E) \
+    X('P', 0x3E, 0x21, 0x21, 0x3E, 0x20, 0x20, 0x20) \
+    X('Q', 0x1E, 0x21, 0x21, 0x21, 0x25, 0x22, 0x1D) \
+    X('R', 0x3E, 0x21, 0x21, 0x3E, 0x24, 0x22, 0x21) \
+    X('S', 0x1F, 0x20, 0x20, 0x1E, 0x01, 0x01, 0x3E) \
+    X('T', 0x3F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04) \
+    X('U', 0x21, 0x21, 0x21, 0x21, 0x21, 0x21, 0x1E) \
+    X('V', 0x21, 0x21, 0x21, 0x21, 0x21, 0x12, 0x0C) \
+    X('W', 0x21, 0x21, 0x21, 0x21, 0x2D, 0x33, 0x21) \
+    X('X', 0x21, 0x12, 0x0C, 0x0C, 0x0C, 0x12, 0x21) \
+    X('Y', 0x21, 0x12, 0x0C, 0x04, 0x04, 0x04, 0x04) \
+    X('Z', 0x3F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x3F) \
+    /* lowercase letters (6x7, shifted-left variants of common 5x7 shapes) */ \
+    X('a', 0x00, 0x00, 0x1C, 0x02, 0x1E, 0x22, 0x1E) \
+    X('b', 0x20, 0x20, 0x3C, 0x22, 0x22, 0x22, 0x3C) \
+    X('c', 0x00, 0x00, 0x1C, 0x20, 0x20, 0x20, 0x1C) \
+    X('d', 0x02, 0x02, 0x1E, 0x22, 0x22, 0x22, 0x1E) \
+    X('e', 0x00, 0x00, 0x1C, 0x22, 0x3E, 0x20, 0x1C) \
+    X('f', 0x0C, 0x10, 0x3C, 0x10, 0x10, 0x10, 0x10) \
+    X('g', 0x00, 0x00, 0x1E, 0x22, 0x1E, 0x02, 0x1C) \
+    X('h', 0x20, 0x20, 0x3C, 0x22, 0x22, 0x22, 0x22) \
+    X('i', 0x08, 0x00, 0x18, 0x08, 0x08, 0x08, 0x1C) \
+    X('j', 0x04, 0x00, 0x0C, 0x04, 0x04, 0x24, 0x18) \
+    X('k', 0x20, 0x24, 0x28, 0x30, 0x28, 0x24, 0x22) \
+    X('l', 0x18, 0x08, 0x08, 0x08, 0x08, 0x08, 0x1C) \
+    X('m', 0x00, 0x00, 0x34, 0x2A, 0x2A, 0x2A, 0x2A) \
+    X('n', 0x00, 0x00, 0x3C, 0x22, 0x22, 0x22, 0x22) \
+    X('o', 0x00, 0x00, 0x1C, 0x22, 0x22, 0x22, 0x1C) \
+    X('p', 0x00, 0x00, 0x3C, 0x22, 0x3C, 0x20, 0x20) \
+    X('q', 0x00, 0x00, 0x1E, 0x22, 0x1E, 0x02, 0x02) \
+    X('r', 0x00, 0x00, 0x2C, 0x30, 0x20, 0x20, 0x20) \
+    X('s', 0x00, 0x00, 0x1E, 0x20, 0x1C, 0x02, 0x3C) \
+    X('t', 0x10, 0x3C, 0x10, 0x10, 0x10, 0x10, 0x0C) \
+    X('u', 0x00, 0x00, 0x22, 0x22, 0x22, 0x26, 0x1A) \
+    X('v', 0x00, 0x00, 0x22, 0x22, 0x14, 0x14, 0x08) \
+    X('w', 0x00, 0x00, 0x22, 0x2A, 0x2A, 0x2A, 0x14) \
+    X('x', 0x00, 0x00, 0x22, 0x14, 0x08, 0x14, 0x22) \
+    X('y', 0x00, 0x00, 0x22, 0x22, 0x1E, 0x02, 0x1C) \
+    X('z', 0x00, 0x00, 0x3E, 0x04, 0x08, 0x10, 0x3E) \
+    /* symbols */ \
+    X('-', 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00) \
+    X('.', 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C) \
+    X('!', 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04) \
+    X(':', 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00) \
+    X(';', 0x00, 0x18, 0x18, 0x00, 0x18, 0x18, 0x10) \
+    X('(', 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02) \
+    X(')', 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08) \
+    X('/', 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x00) \
+    X('\\', 0x20, 0x10, 0x08, 0x04, 0x02, 0x00, 0x00) \
+    X(',', 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x08) \
+    X('\'', 0x04, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00) \
+    X('"', 0x0A, 0x0A, 0x04, 0x00, 0x00, 0x00, 0x00) \
+    X('?', 0x1E, 0x21, 0x01, 0x06, 0x04, 0x00, 0x04) \
+    X('<', 0x04, 0x08, 0x10, 0x20, 0x10, 0x08, 0x04) \
+    X('>', 0x10, 0x08, 0x04, 0x02, 0x04, 0x08, 0x10) \
+    X('[', 0x3C, 0x20, 0x20, 0x20, 0x20, 0x20, 0x3C) \
+    X(']', 0x3C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x3C) \
+    X('{', 0x1C, 0x10, 0x10, 0x20, 0x10, 0x10, 0x1C) \
+    X('}', 0x38, 0x08, 0x08, 0x04, 0x08, 0x08, 0x38) \
+    X('+', 0x00, 0x08, 0x08, 0x3E, 0x08, 0x08, 0x00) \
+    X('=', 0x00, 0x00, 0x3E, 0x00, 0x3E, 0x00, 0x00) \
+    X('_', 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E) \
+    X('@', 0x1C, 0x22, 0x2E, 0x2A, 0x2E, 0x20, 0x1C) \
+    X('#', 0x14, 0x3E, 0x14, 0x14, 0x3E, 0x14, 0x00) \
+    X('$', 0x08, 0x1E, 0x28, 0x1C, 0x0A, 0x3C, 0x08) \
+    X('%', 0x32, 0x32, 0x04, 0x08, 0x10, 0x26, 0x26) \
+    X('&', 0x18, 0x24, 0x28, 0x10, 0x2A, 0x24, 0x1A) \
+    X('*', 0x00, 0x14, 0x08, 0x3E, 0x08, 0x14, 0x00) \
+    X('|', 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08) \
+    X(' ', 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00) \
+    /* code page 437 symbols */ \
+    X(0x07, 0x00, 0x00, 0x0C, 0x1E, 0x1E, 0x0C, 0x00) \
+    X(0x10, 0x20, 0x30, 0x38, 0x3C, 0x38, 0x30, 0x20) \
+    X(0x11, 0x02, 0x06, 0x0E, 0x1E, 0x0E, 0x06, 0x02) \
+    X(0x18, 0x08, 0x1C, 0x2A, 0x08, 0x08, 0x08, 0x08) \
+    X(0x19, 0x08, 0x08, 0x08, 0x08, 0x2A, 0x1C, 0x08) \
+    X(0x1A, 0x00, 0x04, 0x02, 0x3F, 0x02, 0x04, 0x00) \
+    X(0x1B, 0x00, 0x08, 0x10, 0x3F, 0x10, 0x08, 0x00) \
+    X(0x1E, 0x00, 0x08, 0x08, 0x1C, 0x1C, 0x3E, 0x00) \
+    X(0x1F, 0x00, 0x3E, 0x1C, 0x1C, 0x08, 0x08, 0x00) \
+    X(0xF8, 0x0C, 0x12, 0x12, 0x0C, 0x00, 0x00, 0x00) \
+    X(0xFA, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00, 0x00) \
+
+// pixel column c (0 = leftmost) of a 6-wide shape row
+#define SHAPE_BIT(r, c) (((uint32_t)(r) >> (5 - (c))) & 1u)
+
+#define ROW16(m) (uint8_t)((m) >> 8), (uint8_t)((m) & 0xFFu)
+#define ZERO16 0, 0
+
+// 8x8: shape at x offset 1, flush with the top, one blank row below
+#define FONT_8X8_ROWS(r0, r1, r2, r3, r4, r5, r6) \
+    { (r0) << 1, (r1) << 1, (r2) << 1, (r3) << 1, (r4) << 1, (r5) << 1, (r6) << 1, 0 }
+
+// 8x16: shape at x offset 1, y offset 4
+#define FONT_8X16_ROWS(r0, r1, r2, r3, r4, r5, r6) \
+    { 0, 0, 0, 0, (r0) << 1, (r1) << 1, (r2) << 1, (r3) << 1, (r4) << 1, (r5) << 1, (r6) << 1, 0, 0, 0, 0, 0 }
+
+// 12x24: roughly 1.5x of 8x16; the outer columns are doubled, and so are
+// shape rows 0, 1, 3, 5 and 6 while rows 2 and 4 stay single, which turns
+// the 7 shape rows into 12
+#define W12(r) \
+    ((SHAPE_BIT(r, 0) * 0x3000u) | (SHAPE_BIT(r, 1) << 11) | (SHAPE_BIT(r, 2) << 10) | \
+     (SHAPE_BIT(r, 3) << 9) | (SHAPE_BIT(r, 4) << 8) | (SHAPE_BIT(r, 5) * 0x00C0u))
+
+#define FONT_12X24_ROWS(r0, r1, r2, r3, r4, r5, r6) \
+    { ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, \
+      ROW16(W12(r0)), ROW16(W12(r0)), ROW16(W12(r1)), ROW16(W12(r1)), \
+      ROW16(W12(r2)), ROW16(W12(r3)), ROW16(W12(r3)), ROW16(W12(r4)), \
+      ROW16(W12(r5)), ROW16(W12(r5)), ROW16(W12(r6)), ROW16(W12(r6)), \
+      ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, ZERO16 }
+
+// 16x32: exactly 2x of 8x16
+#define W16(r) \
+    ((SHAPE_BIT(r, 0) * 0x3000u) | (SHAPE_BIT(r, 1) * 0x0C00u) | (SHAPE_BIT(r, 2) * 0x0300u) | \
+     (SHAPE_BIT(r, 3) * 0x00C0u) | (SHAPE_BIT(r, 4) * 0x0030u) | (SHAPE_BIT(r, 5) * 0x000Cu))
+
+#define FONT_16X32_ROWS(r0, r1, r2, r3, r4, r5, r6) \
+    { ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, \
+      ROW16(W16(r0)), ROW16(W16(r0)), ROW16(W16(r1)), ROW16(W16(r1)), \
+      ROW16(W16(r2)), ROW16(W16(r2)), ROW16(W16(r3)), ROW16(W16(r3)), \
+      ROW16(W16(r4)), ROW16(W16(r4)), ROW16(W16(r5)), ROW16(W16(r5)), \
+      ROW16(W16(r6)), ROW16(W16(r6)), \
+      ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, ZERO16, ZERO16 }
+
+#define FONT_8X8_GLYPH(c, ...) [c] = FONT_8X8_ROWS(__VA_ARGS__),
+#define FONT_8X16_GLYPH(c, ...) [c] = FONT_8X16_ROWS(__VA_ARGS__),
+#define FONT_12X24_GLYPH(c, ...) [c] = FONT_12X24_ROWS(__VA_ARGS__),
+#define FONT_16X32_GLYPH(c, ...) [c] = FONT_16X32_ROWS(__VA_ARGS__),
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+#endif
+
+static struct
+{
+    Psf2Header header;
+    uint8_t glyphs[256][8];
+} _psf2_8x8 = { PSF2_HEADER(8u, 8u, 1u), { FONT_UNKNOWN(FONT_8X8_GLYPH) FONT_SHAPES(FONT_8X8_GLYPH) } };
+
+static struct
+{
+    Psf2Header header;
+    uint8_t glyphs[256][16];
+} _psf2_8x16 = { PSF2_HEADER(8u, 16u, 1u), { FONT_UNKNOWN(FONT_8X16_GLYPH) FONT_SHAPES(FONT_8X16_GLYPH) } };
+
+static struct
+{
+    Psf2Header header;
+    uint8_t glyphs[256][48];
+} _psf2_12x24 = { PSF2_HEADER(12u, 24u, 2u), { FONT_UNKNOWN(FONT_12X24_GLYPH) FONT_SHAPES(FONT_12X24_GLYPH) } };
+
+static struct
+{
+    Psf2Header header;
+    uint8_t glyphs[256][64];
+} _psf2_16x32 = { PSF2_HEADER(16u, 32u, 2u), { FONT_UNKNOWN(FONT_16X32_GLYPH) FONT_SHAPES(FONT_16X32_GLYPH) } };
+
+// which code page positions the shapes above actually fill
+#define FONT_HAS_GLYPH(c, ...) [c] = true,
+
+static const bool _builtin_has_glyph[256] = { FONT_SHAPES(FONT_HAS_GLYPH) };
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+// the built-in fonts are laid out as code page 437; this is the codepoint
+// each position stands for
+static const uint16_t _cp437_unicode[256] =
+{
+    0x0000, 0x263A, 0x263B, 0x2665, 0x2666, 0x2663, 0x2660, 0x2022,
+    0x25D8, 0x25CB, 0x25D9, 0x2642, 0x2640, 0x266A, 0x266B, 0x263C,
+    0x25BA, 0x25C4, 0x2195, 0x203C, 0x00B6, 0x00A7, 0x25AC, 0x21A8,
+    0x2191, 0x2193, 0x2192, 0x2190, 0x221F, 0x2194, 0x25B2, 0x25BC,
+    0x0020, 0x0021, 0x0022, 0x0023, 0x0024, 0x0025, 0x0026, 0x0027,
+    0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+    0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+    0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+    0x0040, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+    0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+    0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+    0x0058, 0x0059, 0x005A, 0x005B, 0x005C, 0x005D, 0x005E, 0x005F,
+    0x0060, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+    0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+    0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+    0x0078, 0x0079, 0x007A, 0x007B, 0x007C, 0x007D, 0x007E, 0x2302,
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,
+    0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,
+    0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,
+    0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+    0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+    0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4,
+    0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+    0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248,
+    0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0,
+};
+
+// Latin-1 letters the fonts have no glyph for are drawn as a base letter
+// plus an accent: 1 grave, 2 acute, 3 circumflex, 4 tilde, 5 diaeresis,
+// 6 ring, 7 cedilla. Indexed from U+00C0; a space means no decomposition.
+#define LATIN1_FIRST 0xC0u
+#define LATIN1_LAST 0xFFu
+
+static const char _latin1_base[64] = "AAAAAA CEEEEIIII NOOOOO  UUUUY  aaaaaa ceeeeiiii nooooo  uuuuy y";
+static const char _latin1_accent[64] = "1234560712351235041234500123520012345607123512350412345001235205";
+
+#define ACCENT_CEDILLA 7u
+#define ACCENT_WIDTH 5u
+
+// two rows each, five pixels wide with the leftmost in bit 4
+static const uint8_t _accents[8][2] =
+{
+    { 0x00, 0x00 },
+    { 0x08, 0x04 },
+    { 0x02, 0x04 },
+    { 0x04, 0x0A },
+    { 0x0D, 0x16 },
+    { 0x00, 0x0A },
+    { 0x0E, 0x0A },
+    { 0x04, 0x0C },
+};
+
+#define FONT_NO_CODEPOINT 0xFFFFu
+
+static Font _builtin[FONT_BUILTIN_COUNT];
+static uint16_t _builtin_codepage[256];
+static bool _builtin_loaded;
+
+static uint32_t read_le32(const uint8_t* bytes)
+{
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+bool font_load_psf2(const void* data, size_t size, Font* out_font)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    if (!bytes || !out_font || size < PSF2_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    if (read_le32(bytes + 0) != PSF2_MAGIC)
+    {
+        printf("font: bad psf2 magic\n");
+        return false;
+    }
+
+    const uint32_t header_size = read_le32(bytes + 8);
+    const uint32_t flags = read_le32(bytes + 12);
+    const uint32_t length = read_le32(bytes + 16);
+    const uint32_t glyph_size = read_le32(bytes + 20);
+    const uint32_t height = read_le32(bytes + 24);
+    const uint32_t width = read_le32(bytes + 28);
+    const uint32_t row_bytes = (width + 7u) / 8u;
+
+    // the renderer reads at most 32 pixels per row, and '?' has to exist
+    if (width == 0 || width > 32 || height == 0 || glyph_size != row_bytes * height || length < 128)
+    {
+        printf("font: unsupported psf2 %ux%u\n", width, height);
+        return false;
+    }
+
+    if (header_size < PSF2_HEADER_SIZE || header_size > size || (size - header_size) / glyph_size < length)
+    {
+        printf("font: truncated psf2\n");
+        return false;
+    }
+
+    out_font->width = width;
+    out_font->height = height;
+    out_font->row_bytes = row_bytes;
+    out_font->glyph_size = glyph_size;
+    out_font->glyph_count = length;
+    out_font->glyphs = bytes + header_size;
+    out_font->codepage = 0;
+    out_font->unicode = 0;
+    out_font->unicode_size = 0;
+    out_font->ascii_direct = true;
+
+    if (flags & PSF2_HAS_UNICODE_TABLE)
+    {
+        const size_t table = header_size + (size_t)length * glyph_size;
+        out_font->unicode = bytes + table;
+        out_font->unicode_size = size - table;
+
+        // most fonts keep ASCII at its own index, which lets the renderer
+        // skip the table for plain text
+        for (uint32_t c = 0x20; c < 0x7F && out_font->ascii_direct; c++)
+        {
+            uint32_t index = 0;
+            out_font->ascii_direct = font_find_glyph(out_font, c, &index) && index == c;
+        }
+    }
+
+    return true;
+}
+
+bool font_find_glyph(const Font* font, uint32_t codepoint, uint32_t* out_index)
+{
+    if (font->codepage)
+    {
+        for (uint32_t i = 0; i < font->glyph_count; i++)
+        {
+            if (font->codepage[i] == codepoint)
+            {
+                *out_index = i;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    if (font->unicode)
+    {
+        // one run of UTF-8 codepoints per glyph, ended by 0xFF; anything
+        // after a 0xFE is a multi-codepoint sequence and is skipped
+        Utf8Decoder decoder = { 0 };
+        uint32_t glyph = 0;
+        bool sequence = false;
+
+        for (size_t i = 0; i < font->unicode_size && glyph < font->glyph_count; i++)
+        {
+            const uint8_t byte = font->unicode[i];
+
+            if (byte == PSF2_SEPARATOR)
+            {
+                glyph++;
+                sequence = false;
+                decoder.remaining = 0;
+                continue;
+            }
+
+            if (byte == PSF2_START_SEQUENCE)
+            {
+                sequence = true;
+                continue;
+            }
+
+            uint32_t decoded = 0;
+            if (!sequence && utf8_decode(&decoder, byte, &decoded) == UTF8_DONE && decoded == codepoint)
+            {
+                *out_index = glyph;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    if (codepoint < font->glyph_count)
+    {
+        *out_index = codepoint;
+        return true;
+    }
+
+    return false;
+}
+
+static void glyph_set_pixel(const Font* font, uint8_t* glyph, uint32_t x, uint32_t y)
+{
+    if (x < font->width && y < font->height)
+    {
+        glyph[y * font->row_bytes + x / 8u] |= (uint8_t)(0x80u >> (x % 8u));
+    }
+}
+
+static bool glyph_row_empty(const Font* font, const uint8_t* glyph, uint32_t y)
+{
+    for (uint32_t b = 0; b < font->row_bytes; b++)
+    {
+        if (glyph[y * font->row_bytes + b])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// draws an accent a pixel unit above the letter's first row, or below its
+// last one for a cedilla; the unit grows with the font
+static void glyph_add_accent(const Font* font, uint8_t* glyph, uint32_t accent)
+{
+    uint32_t top = 0;
+    while (top < font->height && glyph_row_empty(font, glyph, top))
+    {
+        top++;
+    }
+
+    uint32_t bottom = font->height;
+    while (bottom > top && glyph_row_empty(font, glyph, bottom - 1))
+    {
+        bottom--;
+    }
+
+    const uint32_t unit = (font->height >= 32u) ? 2u : 1u;
+    const uint32_t left = (font->width > ACCENT_WIDTH * unit) ? (font->width - ACCENT_WIDTH * unit) / 2u : 0u;
+
+    uint32_t y0 = 0;
+    if (accent == ACCENT_CEDILLA)
+    {
+        y0 = bottom;
+    }
+    else if (top >= 3u * unit)
+    {
+        y0 = top - 3u * unit;
+    }
+
+    for (uint32_t row = 0; row < 2u; row++)
+    {
+        for (uint32_t col = 0; col < ACCENT_WIDTH; col++)
+        {
+            if ((_accents[accent][row] & (0x10u >> col)) == 0)
+            {
+                continue;
+            }
+
+            for (uint32_t dy = 0; dy < unit; dy++)
+            {
+                for (uint32_t dx = 0; dx < unit; dx++)
+                {
+                    glyph_set_pixel(font, glyph, left + col * unit + dx, y0 + row * unit + dy);
+                }
+            }
+        }
+    }
+}
+
+void font_render_glyph(const Font* font, uint32_t codepoint, uint8_t* out_glyph)
+{
+    uint32_t index = 0;
+
+    if (font_find_glyph(font, codepoint, &index))
+    {
+        memcpy(out_glyph, font_glyph(font, index), font->glyph_size);
+        return;
+    }
+
+    if (codepoint >= LATIN1_FIRST && codepoint <= LATIN1_LAST && _latin1_base[codepoint - LATIN1_FIRST] != ' ' &&
+        font_find_glyph(font, (uint8_t)_latin1_base[codepoint - LATIN1_FIRST], &index))
+    {
+        memcpy(out_glyph, font_glyph(font, index), font->glyph_size);
+        glyph_add_accent(font, out_glyph, (uint32_t)(_latin1_accent[codepoint - LATIN1_FIRST] - '0'));
+        return;
+    }
+
+    if (!font_find_glyph(font, '?', &index))
+    {
+        index = '?';
+    }
+
+    memcpy(out_glyph, font_glyph(font, index), font->glyph_size);
+}
+
+uint32_t font_cp437_to_unicode(uint8_t byte)
+{
+    return _cp437_unicode[byte];
+}
+
+uint8_t font_unicode_to_cp437(uint32_t codepoint)
+{
+    for (uint32_t i = 0; i < 256u; i++)
+    {
+        if (_cp437_unicode[i] == codepoint)
+        {
+            return (uint8_t)i;
+        }
+    }
+
+    return '?';
+}
+
+// Box drawing and block characters, at their code page 437 positions. They
+// are rendered into each built-in font once when the fonts are first used,
+// sized to that font's cell, so they are ordinary glyphs to the renderer.
+#define BOX_UP 0x01u
+#define BOX_DOWN 0x02u
+#define BOX_LEFT 0x04u
+#define BOX_RIGHT 0x08u
+
+typedef enum
+{
+    BOX_SINGLE,
+    BOX_DOUBLE,
+    BOX_SHADE_LIGHT,
+    BOX_SHADE_MEDIUM,
+    BOX_SHADE_DARK,
+    BOX_BLOCK_FULL,
+    BOX_BLOCK_LOWER,
+    BOX_BLOCK_UPPER,
+    BOX_SQUARE,
+} BoxStyle;
+
+static const struct
+{
+    uint8_t position;
+    uint8_t style;
+    uint8_t arms;
+} _box_glyphs[] =
+{
+    { 0xB3, BOX_SINGLE, BOX_UP | BOX_DOWN },
+    { 0xB4, BOX_SINGLE, BOX_UP | BOX_DOWN | BOX_LEFT },
+    { 0xBF, BOX_SINGLE, BOX_DOWN | BOX_LEFT },
+    { 0xC0, BOX_SINGLE, BOX_UP | BOX_RIGHT },
+    { 0xC1, BOX_SINGLE, BOX_UP | BOX_LEFT | BOX_RIGHT },
+    { 0xC2, BOX_SINGLE, BOX_DOWN | BOX_LEFT | BOX_RIGHT },
+    { 0xC3, BOX_SINGLE, BOX_UP | BOX_DOWN | BOX_RIGHT },
+    { 0xC4, BOX_SINGLE, BOX_LEFT | BOX_RIGHT },
+    { 0xC5, BOX_SINGLE, BOX_UP | BOX_DOWN | BOX_LEFT | BOX_RIGHT },
+    { 0xD9, BOX_SINGLE, BOX_UP | BOX_LEFT },
+    { 0xDA, BOX_SINGLE, BOX_DOWN | BOX_RIGHT },
+
+    { 0xB9, BOX_DOUBLE, BOX_UP | BOX_DOWN | BOX_LEFT },
+    { 0xBA, BOX_DOUBLE, BOX_UP | BOX_DOWN },
+    { 0xBB, BOX_DOUBLE, BOX_DOWN | BOX_LEFT },
+    { 0xBC, BOX_DOUBLE, BOX_UP | BOX_LEFT },
+    { 0xC8, BOX_DOUBLE, BOX_UP | BOX_RIGHT },
+    { 0xC9, BOX_DOUBLE, BOX_DOWN | BOX_RIGHT },
+    { 0xCA, BOX_DOUBLE, BOX_UP | BOX_LEFT | BOX_RIGHT },
+    { 0xCB, BOX_DOUBLE, BOX_DOWN | BOX_LEFT | BOX_RIGHT },
+    { 0xCC, BOX_DOUBLE, BOX_UP | BOX_DOWN | BOX_RIGHT },
+    { 0xCD, BOX_DOUBLE, BOX_LEFT | BOX_RIGHT },
+    { 0xCE, BOX_DOUBLE, BOX_UP | BOX_DOWN | BOX_LEFT | BOX_RIGHT },
+
+    { 0xB0, BOX_SHADE_LIGHT, 0 },
+    { 0xB1, BOX_SHADE_MEDIUM, 0 },
+    { 0xB2, BOX_SHADE_DARK, 0 },
+    { 0xDB, BOX_BLOCK_FULL, 0 },
+    { 0xDC, BOX_BLOCK_LOWER, 0 },
+    { 0xDF, BOX_BLOCK_UPPER, 0 },
+    { 0xFE, BOX_SQUARE, 0 },
+};
+
+typedef struct
+{
+    uint32_t arms;
+    int32_t cx, cy;
+    int32_t unit;
+} BoxShape;
+
+// A single line is one unit thick through the cell centre. A double line
+// is traced as the outline of a channel four units wide, so the strokes of
+// tees, corners and crosses meet without any special cases.
+static bool box_single_inside(const BoxShape* box, int32_t x, int32_t y)
+{
+    const bool vertical = x >= box->cx && x < box->cx + box->unit;
+    const bool horizontal = y >= box->cy && y < box->cy + box->unit;
+
+    return ((box->arms & BOX_UP) && vertical && y < box->cy + box->unit) ||
+           ((box->arms & BOX_DOWN) && vertical && y >= box->cy) ||
+           ((box->arms & BOX_LEFT) && horizontal && x < box->cx + box->unit) ||
+           ((box->arms & BOX_RIGHT) && horizontal && x >= box->cx);
+}
+
+static bool box_channel_inside(const BoxShape* box, int32_t x, int32_t y)
+{
+    const int32_t half = 2 * box->unit;
+    const bool vertical = x >= box->cx - half && x <= box->cx + half;
+    const bool horizontal = y >= box->cy - half && y <= box->cy + half;
+
+    return (vertical && horizontal) ||
+           ((box->arms & BOX_UP) && vertical && y <= box->cy) ||
+           ((box->arms & BOX_DOWN) && vertical && y >= box->cy) ||
+           ((box->arms & BOX_LEFT) && horizontal && x <= box->cx) ||
+           ((box->arms & BOX_RIGHT) && horizontal && x >= box->cx);
+}
+
+static bool box_double_lit(const BoxShape* box, int32_t x, int32_t y)
+{
+    if (!box_channel_inside(box, x, y))
+    {
+        return false;
+    }
+
+    const int32_t u = box->unit;
+    for (int32_t dy = -u; dy <= u; dy += u)
+    {
+        for (int32_t dx = -u; dx <= u; dx += u)
+        {
+            if (!box_channel_inside(box, x + dx, y + dy))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+static bool box_pixel(const Font* font, uint8_t style, const BoxShape* box, uint32_t x, uint32_t y)
+{
+    const uint32_t w = font->width;
+    const uint32_t h = font->height;
+    const uint32_t side = w / 2u;
+
+    switch (style)
+    {
+        case BOX_SINGLE:
+            return box_single_inside(box, (int32_t)x, (int32_t)y);
+        case BOX_DOUBLE:
+            return box_double_lit(box, (int32_t)x, (int32_t)y);
+        case BOX_SHADE_LIGHT:
+            return (y % 2u == 0) ? (x % 4u == 0) : (x % 4u == 2u);
+        case BOX_SHADE_MEDIUM:
+            return (x + y) % 2u == 0;
+        case BOX_SHADE_DARK:
+            return !((y % 2u == 0) ? (x % 4u == 0) : (x % 4u == 2u));
+        case BOX_BLOCK_FULL:
+            return true;
+        case BOX_BLOCK_LOWER:
+            return y >= h / 2u;
+        case BOX_BLOCK_UPPER:
+            return y < h / 2u;
+        case BOX_SQUARE:
+            return x >= (w - side) / 2u && x < (w + side) / 2u && y >= (h - side) / 2u && y < (h + side) / 2u;
+        default:
+            return false;
+    }
+}
+
+static void box_render_all(const Font* font, uint8_t* glyphs)
+{
+    // strokes thicken with the cell so the large fonts keep their weight
+    const int32_t unit = (font->height >= 32u) ? 2 : 1;
+
+    for (size_t i = 0; i < sizeof(_box_glyphs) / sizeof(_box_glyphs[0]); i++)
+    {
+        uint8_t* glyph = glyphs + (size_t)_box_glyphs[i].position * font->glyph_size;
+        const BoxShape box =
+        {
+            _box_glyphs[i].arms,
+            (int32_t)font->width / 2 - unit / 2,
+            (int32_t)font->height / 2 - unit / 2,
+            unit,
+        };
+
+        memset(glyph, 0, font->glyph_size);
+
+        for (uint32_t y = 0; y < font->height; y++)
+        {
+            for (uint32_t x = 0; x < font->width; x++)
+            {
+                if (box_pixel(font, _box_glyphs[i].style, &box, x, y))
+                {
+                    glyph_set_pixel(font, glyph, x, y);
+                }
+            }
+        }
+    }
+}
+
+const Font* font_builtin(FontId id)
+{
+    if (!_builtin_loaded)
+    {
+        font_load_psf2(&_psf2_8x8, sizeof(_psf2_8x8), &_builtin[FONT_8X8]);
+        font_load_psf2(&_psf2_8x16, sizeof(_psf2_8x16), &_builtin[FONT_8X16]);
+        font_load_psf2(&_psf2_12x24, sizeof(_psf2_12x24), &_builtin[FONT_12X24]);
+        font_load_psf2(&_psf2_16x32, sizeof(_psf2_16x32), &_builtin[FONT_16X32]);
+
+        box_render_all(&_builtin[FONT_8X8], &_psf2_8x8.glyphs[0][0]);
+        box_render_all(&_builtin[FONT_8X16], &_psf2_8x16.glyphs[0][0]);
+        box_render_all(&_builtin[FONT_12X24], &_psf2_12x24.glyphs[0][0]);
+        box_render_all(&_builtin[FONT_16X32], &_psf2_16x32.glyphs[0][0]);
+
+        // positions without a shape claim no codepoint, so lookups fall
+        // through to composing or '?'
+        for (size_t i = 0; i < 256u; i++)
+        {
+            _builtin_codepage[i] = _builtin_has_glyph[i] ? _cp437_unicode[i] : FONT_NO_CODEPOINT;
+        }
+
+        for (size_t i = 0; i < sizeof(_box_glyphs) / sizeof(_box_glyphs[0]); i++)
+        {
+            _builtin_codepage[_box_glyphs[i].position] = (uint16_t)_cp437_unicode[_box_glyphs[i].position];
+        }
+
+        for (size_t i = 0; i < FONT_BUILTIN_COUNT; i++)
+        {
+            _builtin[i].codepage = _builtin_codepage;
+        }
+
+        _builtin_loaded = true;
+    }
+
+    if ((uint32_t)id >= FONT_BUILTIN_COUNT)
+    {
+        return 0;
+    }
+
+    return &_builtin[id];
+}
+
+const Font* font_for_resolution(uint32_t width, uint32_t height)
+{
+    // the dashboard wants about 120x40 cells; below that stay on 8x16
+    static const FontId candidates[] = { FONT_16X32, FONT_12X24 };
+
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++)
+    {
+        const Font* font = font_builtin(candidates[i]);
+        if (width / font->width >= 120u && height / font->height >= 40u)
+        {
+            return font;
+        }
+    }
+
+    return font_builtin(FONT_8X16);
+}
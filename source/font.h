@@ -0,0 +1,75 @@
+#ifndef STRATUS_FONT_H
+#define STRATUS_FONT_H
+
+// Stratus: font.h
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bitmap font in PSF2 layout: each glyph is height rows of row_bytes bytes,
+// leftmost pixel in the top bit of the first byte.
+typedef struct
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t row_bytes;
+    uint32_t glyph_size;
+    uint32_t glyph_count;
+    const uint8_t* glyphs;
+
+    // codepoint of each glyph, either as a flat table (the built-in code
+    // page) or as a PSF2 unicode table; with neither, glyph index and
+    // codepoint are the same
+    const uint16_t* codepage;
+    const uint8_t* unicode;
+    size_t unicode_size;
+
+    // true when U+0020..U+007E sit at their own glyph index
+    bool ascii_direct;
+} Font;
+
+// built-in sizes, all compiled into the kernel image as PSF2 data
+typedef enum
+{
+    FONT_8X8,
+    FONT_8X16,
+    FONT_12X24,
+    FONT_16X32,
+    FONT_BUILTIN_COUNT,
+} FontId;
+
+// Parses a PSF2 image in place; the glyph data is referenced, not copied.
+bool font_load_psf2(const void* data, size_t size, Font* out_font);
+
+// Codepoint to glyph index through the font's table. This is a linear scan,
+// so callers on the drawing path should cache the result.
+bool font_find_glyph(const Font* font, uint32_t codepoint, uint32_t* out_index);
+
+// Writes the glyph_size bytes of bitmap for a codepoint. Accented Latin-1
+// letters the font lacks are composed from the base letter; anything else
+// missing comes out as '?'.
+void font_render_glyph(const Font* font, uint32_t codepoint, uint8_t* out_glyph);
+
+// the byte encoding the char-based console calls use above 0x7F
+uint32_t font_cp437_to_unicode(uint8_t byte);
+uint8_t font_unicode_to_cp437(uint32_t codepoint);
+
+const Font* font_builtin(FontId id);
+
+// largest built-in font that still leaves a usable grid on a screen this size
+const Font* font_for_resolution(uint32_t width, uint32_t height);
+
+// glyphs past the end of the font fall back to '?'
+static inline const uint8_t* font_glyph(const Font* font, uint32_t index)
+{
+    if (index >= font->glyph_count)
+    {
+        index = '?';
+    }
+
+    return font->glyphs + (size_t)index * font->glyph_size;
+}
+
+#endif
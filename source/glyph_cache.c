@@ -0,0 +1,218 @@
+// Stratus: glyph_cache.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include "glyph_cache.h"
+
+#define GLYPH_CACHE_NONE 0xFFFFu
+
+typedef struct
+{
+    const Font* font;
+    uint32_t codepoint;
+
+    // bucket chain, and the recency list with the newest entry at the head
+    uint16_t hash_next;
+    uint16_t lru_prev;
+    uint16_t lru_next;
+} GlyphCacheEntry;
+
+static GlyphCacheEntry _entries[GLYPH_CACHE_ENTRIES];
+static uint8_t _bitmaps[GLYPH_CACHE_ENTRIES][GLYPH_CACHE_MAX_GLYPH_SIZE];
+static uint16_t _buckets[GLYPH_CACHE_BUCKETS];
+
+static uint16_t _lru_head;
+static uint16_t _lru_tail;
+static bool _ready;
+
+static GlyphCacheStats _stats;
+
+static uint32_t glyph_cache_hash(const Font* font, uint32_t codepoint)
+{
+    uint32_t hash = codepoint * 0x9E3779B1u;
+    hash ^= (uint32_t)(uintptr_t)font >> 4;
+    return (hash ^ (hash >> 16)) % GLYPH_CACHE_BUCKETS;
+}
+
+static void glyph_cache_setup(void)
+{
+    for (uint32_t i = 0; i < GLYPH_CACHE_BUCKETS; i++)
+    {
+        _buckets[i] = GLYPH_CACHE_NONE;
+    }
+
+    // every entry starts out empty, in the list in index order
+    for (uint32_t i = 0; i < GLYPH_CACHE_ENTRIES; i++)
+    {
+        _entries[i].font = 0;
+        _entries[i].hash_next = GLYPH_CACHE_NONE;
+        _entries[i].lru_prev = (i == 0) ? GLYPH_CACHE_NONE : (uint16_t)(i - 1);
+        _entries[i].lru_next = (i + 1 == GLYPH_CACHE_ENTRIES) ? GLYPH_CACHE_NONE : (uint16_t)(i + 1);
+    }
+
+    _lru_head = 0;
+    _lru_tail = GLYPH_CACHE_ENTRIES - 1;
+    _ready = true;
+}
+
+static void lru_unlink(uint16_t index)
+{
+    GlyphCacheEntry* entry = &_entries[index];
+
+    if (entry->lru_prev != GLYPH_CACHE_NONE)
+    {
+        _entries[entry->lru_prev].lru_next = entry->lru_next;
+    }
+    else
+    {
+        _lru_head = entry->lru_next;
+    }
+
+    if (entry->lru_next != GLYPH_CACHE_NONE)
+    {
+        _entries[entry->lru_next].lru_prev = entry->lru_prev;
+    }
+    else
+    {
+        _lru_tail = entry->lru_prev;
+    }
+}
+
+static void lru_push_front(uint16_t index)
+{
+    GlyphCacheEntry* entry = &_entries[index];
+
+    entry->lru_prev = GLYPH_CACHE_NONE;
+    entry->lru_next = _lru_head;
+
+    if (_lru_head != GLYPH_CACHE_NONE)
+    {
+        _entries[_lru_head].lru_prev = index;
+    }
+    else
+    {
+        _lru_tail = index;
+    }
+
+    _lru_head = index;
+}
+
+static void lru_push_back(uint16_t index)
+{
+    GlyphCacheEntry* entry = &_entries[index];
+
+    entry->lru_prev = _lru_tail;
+    entry->lru_next = GLYPH_CACHE_NONE;
+
+    if (_lru_tail != GLYPH_CACHE_NONE)
+    {
+        _entries[_lru_tail].lru_next = index;
+    }
+    else
+    {
+        _lru_head = index;
+    }
+
+    _lru_tail = index;
+}
+
+static void bucket_remove(uint16_t index)
+{
+    const GlyphCacheEntry* entry = &_entries[index];
+    uint16_t* link = &_buckets[glyph_cache_hash(entry->font, entry->codepoint)];
+
+    while (*link != GLYPH_CACHE_NONE)
+    {
+        if (*link == index)
+        {
+            *link = entry->hash_next;
+            return;
+        }
+
+        link = &_entries[*link].hash_next;
+    }
+}
+
+const uint8_t* glyph_cache_get(const Font* font, uint32_t codepoint)
+{
+    if (font->glyph_size > GLYPH_CACHE_MAX_GLYPH_SIZE)
+    {
+        // only fonts past 32x32 get here; they keep to the direct range
+        return font_glyph(font, '?');
+    }
+
+    if (!_ready)
+    {
+        glyph_cache_setup();
+    }
+
+    const uint32_t bucket = glyph_cache_hash(font, codepoint);
+
+    for (uint16_t i = _buckets[bucket]; i != GLYPH_CACHE_NONE; i = _entries[i].hash_next)
+    {
+        if (_entries[i].codepoint == codepoint && _entries[i].font == font)
+        {
+            if (i != _lru_head)
+            {
+                lru_unlink(i);
+                lru_push_front(i);
+            }
+
+            _stats.hits++;
+            return _bitmaps[i];
+        }
+    }
+
+    // reuse the least recently used entry
+    const uint16_t victim = _lru_tail;
+    GlyphCacheEntry* entry = &_entries[victim];
+
+    if (entry->font)
+    {
+        bucket_remove(victim);
+        _stats.evictions++;
+    }
+
+    entry->font = font;
+    entry->codepoint = codepoint;
+    entry->hash_next = _buckets[bucket];
+    _buckets[bucket] = victim;
+
+    lru_unlink(victim);
+    lru_push_front(victim);
+
+    font_render_glyph(font, codepoint, _bitmaps[victim]);
+    _stats.misses++;
+    return _bitmaps[victim];
+}
+
+void glyph_cache_flush(const Font* font)
+{
+    if (!_ready)
+    {
+        return;
+    }
+
+    for (uint16_t i = 0; i < GLYPH_CACHE_ENTRIES; i++)
+    {
+        if (_entries[i].font != font)
+        {
+            continue;
+        }
+
+        // emptied entries go to the back of the list so they are reused first
+        bucket_remove(i);
+        _entries[i].font = 0;
+        _entries[i].hash_next = GLYPH_CACHE_NONE;
+
+        lru_unlink(i);
+        lru_push_back(i);
+    }
+}
+
+void glyph_cache_get_stats(GlyphCacheStats* out_stats)
+{
+    if (out_stats)
+    {
+        *out_stats = _stats;
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef STRATUS_GLYPH_CACHE_H
+#define STRATUS_GLYPH_CACHE_H
+
+// Stratus: glyph_cache.h
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "font.h"
+
+// Glyph bitmaps for codepoints the renderer cannot index directly, keyed by
+// font (and so by cell size) and codepoint. Resolving one can mean scanning
+// a unicode table or composing an accented letter; that happens once, and
+// the result stays until it is the least recently used entry.
+#define GLYPH_CACHE_ENTRIES 256u
+#define GLYPH_CACHE_BUCKETS 512u
+#define GLYPH_CACHE_MAX_GLYPH_SIZE (32u * 4u)
+
+typedef struct
+{
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+} GlyphCacheStats;
+
+// Returns the bitmap in the font's own row layout; it stays valid until
+// GLYPH_CACHE_ENTRIES other glyphs have been looked up.
+const uint8_t* glyph_cache_get(const Font* font, uint32_t codepoint);
+
+// Drops every glyph cached for font. Entries are keyed by the Font's
+// address, so this must be called before a Font is reloaded in place.
+void glyph_cache_flush(const Font* font);
+
+void glyph_cache_get_stats(GlyphCacheStats* out_stats);
+
+#endif
@@ -9,6 +9,12 @@
 #include "defs.h"
 #include "platform.h"
 #include "fb_console.h"
+#include "virtio_gpu.h"
+#include "virtio_input.h"
+#include "scrollback.h"
+#include "surface.h"
+#include "utf8.h"
+#include "widget.h"
 
 #define COPYRIGHT_LOGO "STRATUS - (c) 2026 Connor J. Link. All Rights Reserved."
 
@@ -25,213 +31,141 @@ static uint8_t invert_color(uint8_t color)
 static size_t g_term_cols = 80;
 static size_t g_term_rows = 25;
 
-void render_text_center(const char* data, size_t x0, size_t x1, size_t y)
+// Every part of the main screen draws into its own off-screen surface, in
+// that surface's coordinates; the compositor then copies what changed onto
+// the screen.
+static Surface _header_surface;
+static Surface _footer_surface;
+static Surface _explorer_surface;
+static Surface _console_surface;
+static Surface _navigator_surface;
+
+// a pane's surface covers its group box, border included
+static Rect pane_surface_rect(Rect pane)
 {
-    const size_t length = strlen(data);
-    const size_t midpoint = (x0 + x1) / 2;
-    
-    const size_t begin = midpoint - (length / 2);
-    terminal_write(data, length, begin, y);
+    return RECT(pane.pos, POINT(pane.size.x + 1, pane.size.y + 1));
 }
 
-void render_menubar()
+// the pane's group box in its own surface's coordinates
+static Rect pane_local(Rect pane)
 {
-    const size_t header_row = 0;
-    const size_t copyright_row = (g_term_rows == 0) ? 0 : (g_term_rows - 1);
-
-    _active_color = invert_color(_active_color);
-
-    for (size_t x = 0; x < g_term_cols; x++)
-    {
-        terminal_putentryat(' ', _active_color, x, header_row);
-        terminal_putentryat(' ', _active_color, x, copyright_row);
-    }
-
-    render_text_center("Configuration", 0, g_term_cols ? (g_term_cols - 1) : 0, header_row);
-    render_text_center(COPYRIGHT_LOGO, 0, g_term_cols ? (g_term_cols - 1) : 0, copyright_row);
-
-    _active_color = invert_color(_active_color);
+    return RECT(POINT(0, 0), pane.size);
 }
 
-void render_groupbox(Rect rect, uint8_t color, const char* title, bool is_selected)
+static void layout_surfaces(void)
 {
-    const size_t left = rect.pos.x;
-    const size_t right = rect.pos.x + rect.size.x;
-
-    const size_t top = rect.pos.y;
-    const size_t bottom = rect.pos.y + rect.size.y;
-
-    static const char horizontal_line = '\xC4';
-    static const char vertical_line = '\xB3';
-
-    static const char top_left_corner = '\xDA';
-    static const char top_right_corner = '\xBF';
-    static const char bottom_left_corner = '\xC0';
-    static const char bottom_right_corner = '\xD9';
-
-    // draw top line
-    for (size_t x = left; x <= right; x++)
-    {
-        terminal_putentryat(horizontal_line, color, x, top);
-    }
-
-    // draw bottom line
-    for (size_t x = left; x <= right; x++)
-    {
-        terminal_putentryat(horizontal_line, color, x, bottom);
-    }
-
-    // draw left line
-    for (size_t y = top; y <= bottom; y++)
-    {
-        terminal_putentryat(vertical_line, color, left, y);
-    }
-
-    // draw right line
-    for (size_t y = top; y <= bottom; y++)
-    {
-        terminal_putentryat(vertical_line, color, right, y);
-    }
-
-    // draw corners properly
-    terminal_putentryat(top_left_corner, color, left, top);
-    terminal_putentryat(top_right_corner, color, right, top);
-    terminal_putentryat(bottom_left_corner, color, left, bottom);
-    terminal_putentryat(bottom_right_corner, color, right, bottom);
-
-    const size_t text_left = left + 2;
-    const size_t text_right = right - 2;
-
-    const size_t title_length = strlen(title);
+    surface_init(&_header_surface, RECT(POINT(0, 0), POINT(g_term_cols, 1)), _active_color);
+    surface_init(&_footer_surface, RECT(POINT(0, g_term_rows ? (g_term_rows - 1) : 0), POINT(g_term_cols, 1)), _active_color);
+    surface_init(&_explorer_surface, pane_surface_rect(_explorer_rect), _active_color);
+    surface_init(&_console_surface, pane_surface_rect(_console_rect), _active_color);
+    surface_init(&_navigator_surface, pane_surface_rect(_navigator_rect), _active_color);
+}
 
-    const size_t max_length = text_right - text_left;
-    const int32_t difference = title_length - max_length;
-    
-    const size_t max_right = min(text_right, text_left + title_length - 1);
+// console pane history; only the visible window is ever drawn
+#define CONSOLE_HISTORY_LINES 10000u
+#define CONSOLE_HISTORY_WIDTH 192u
 
-    if (is_selected)
-    {
-        color = invert_color(color);
-    }
+static Scrollback _console_log;
 
-    for (size_t x = text_left; x <= max_right; x++)
-    {
-        terminal_putentryat(title[x - text_left], color, x, top);
-    }
-
-    if (difference > 0)
-    {
-        // terminal_putentryat(ellipses, color, text_right, top);
-    }
+// inside the console's border, in its surface's coordinates
+static Rect console_interior(void)
+{
+    return RECT(POINT(1, 1), POINT(_console_rect.size.x - 1, _console_rect.size.y - 1));
 }
 
-void render_text(Rect parent, Point pos, uint8_t color, const char* text)
+static void render_console_line(Rect interior, size_t row)
 {
-    const size_t start_left = parent.pos.x + pos.x + 1;
-    const size_t start_top = parent.pos.y + pos.y + 1;
+    const size_t age = _console_log.view + (interior.size.y - 1 - row);
 
-    const size_t parent_right = parent.pos.x + parent.size.x - 1;
+    size_t length = 0;
+    uint8_t color = _active_color;
+    const char* text = scrollback_line(&_console_log, age, &length, &color);
 
-    const size_t text_length = strlen(text);
-
-    size_t x = start_left;
-    size_t y = start_top;
-
-    for (size_t i = 0; i < text_length; i++)
+    // history is UTF-8; one codepoint per cell
+    size_t i = 0;
+    for (size_t x = 0; x < interior.size.x; x++)
     {
-        char c = text[i];
-
-        if (x == parent_right ||
-            c == '\n')
+        uint32_t codepoint = ' ';
+        if (text && i < length)
         {
-            y++;
-            x = start_left;
+            i += utf8_next(&text[i], length - i, &codepoint);
         }
 
-        terminal_putentryat(c, color, x, y);
-
-        x++;
+        surface_putcodepointat(&_console_surface, codepoint, text ? color : _active_color, interior.pos.x + x,
+                               interior.pos.y + row);
     }
 }
 
-void render_text_justified(Rect parent, Point pos, uint8_t color, const char* text)
+void render_console(void)
 {
-    const uint8_t color_cached = _active_color;
-    _active_color = color;
-
-    const size_t left = parent.pos.x + pos.x + 1;
-    const size_t right = parent.pos.x + parent.size.x + pos.x;
-
-    const size_t top = parent.pos.y + pos.y + 1;
+    const Rect interior = console_interior();
 
-    render_text_center(text, left, right, top);
-
-    _active_color = color_cached;
+    for (size_t row = 0; row < interior.size.y; row++)
+    {
+        render_console_line(interior, row);
+    }
 }
 
-void scroll_rect(Rect parent, uint8_t color)
+void write_console(uint8_t color, const char* text)
 {
-    const size_t left = parent.pos.x + 1;
-    const size_t right = parent.pos.x + parent.size.x;
+    const Rect interior = console_interior();
+    const size_t width = min(interior.size.x, CONSOLE_HISTORY_WIDTH);
 
-    const size_t top = parent.pos.y + 1;
-    const size_t bottom = parent.pos.y + parent.size.y - 1;
-
-    for (size_t y = top; y < bottom; y++)
+    // one history line per pane-width piece of each text line, counted in
+    // codepoints and never splitting one
+    const char* line = text;
+    for (;;)
     {
-        for (size_t x = left; x < right; x++)
+        size_t end = 0;
+        while (line[end] && line[end] != '\n')
         {
-            char c;
-            uint8_t ccolor;
-            if (!terminal_getentryat(x, y + 1, &c, &ccolor))
+            end++;
+        }
+
+        size_t length = 0;
+        for (size_t columns = 0; length < end && columns < width; columns++)
+        {
+            uint32_t codepoint = 0;
+            const size_t step = utf8_next(&line[length], end - length, &codepoint);
+            if (length + step > CONSOLE_HISTORY_WIDTH)
             {
-                c = ' ';
-                ccolor = color;
+                break;
             }
 
-            terminal_putentryat(c, ccolor, x, y);
+            length += step;
         }
-    }
 
-    for (size_t x = left; x < right; x++)
-    {
-        terminal_putentryat(' ', color, x, bottom);
-    }
-}
-
-void erase_rect(Rect rect, uint8_t color)
-{
-    const size_t left = rect.pos.x + 1;
-    const size_t right = rect.pos.x + rect.size.x;
+        scrollback_push(&_console_log, line, length, color);
 
-    const size_t top = rect.pos.y + 1;
-    const size_t bottom = rect.pos.y + rect.size.y - 1;
+        // at the bottom the pane follows along; a scrolled-back view is left
+        // exactly as it is
+        if (_console_log.view == 0)
+        {
+            surface_scroll(&_console_surface, interior, 1, _active_color);
+            render_console_line(interior, interior.size.y - 1);
+        }
 
-    for (int i = left; i < right; i++)
-    {
-        for (int j = top; j < bottom; j++)
+        line += length;
+        if (*line == '\n')
+        {
+            line++;
+        }
+        if (*line == '\0')
         {
-            terminal_putentryat(' ', color, i, j);
+            break;
         }
     }
 }
 
-void write_console(Rect parent, Point* cursor, uint8_t color, const char* text)
+static void scroll_console(int32_t pages)
 {
-    const size_t bottom = parent.size.y - 2;
+    const Rect interior = console_interior();
+    const int32_t page = (interior.size.y > 1) ? (int32_t)interior.size.y - 1 : 1;
 
-    if (cursor->y == bottom)
+    if (scrollback_scroll(&_console_log, pages * page, interior.size.y))
     {
-        scroll_rect(parent, color);
-        //cursor->y--;
+        render_console();
     }
-
-    else
-    {
-        cursor->y++;
-    }
-
-    render_text(parent, *cursor, color, text);
 }
 
 void trap_exception_handler(uint32_t scause, uint32_t sepc, uint32_t stval)
@@ -258,51 +192,120 @@ size_t _explorer_index = 0;
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(x[0]))
 
-void render_explorer()
+// The screen's chrome is a tree of widgets per surface. Views and key
+// handlers only change widget state; render_widgets repaints what changed.
+static Widget _header_label;
+static Widget _footer_label;
+static Widget _explorer_box;
+static Widget _explorer_list;
+static Widget _console_box;
+static Widget _navigator_box;
+static Widget _navigator_view;
+
+static void layout_widgets(void)
 {
-    Point point = POINT(0, 0);
+    const uint8_t bar_color = invert_color(_active_color);
 
-    for (size_t i = 0; i < ARRAY_SIZE(_explorer_items); i++)
-    {
-        uint8_t color = _active_color;
+    widget_init(&_header_label, WIDGET_LABEL, &_header_surface, RECT(POINT(0, 0), POINT(g_term_cols, 1)), bar_color);
+    widget_set_align(&_header_label, WIDGET_ALIGN_CENTER);
+    widget_set_text(&_header_label, "Configuration");
 
-        if (_explorer_selected && _explorer_index == i)
-        {
-            color = invert_color(color);
-        }
+    widget_init(&_footer_label, WIDGET_LABEL, &_footer_surface, RECT(POINT(0, 0), POINT(g_term_cols, 1)), bar_color);
+    widget_set_align(&_footer_label, WIDGET_ALIGN_CENTER);
+    widget_set_text(&_footer_label, COPYRIGHT_LOGO);
 
-        render_text(_explorer_rect, point, color, _explorer_items[i]);
-        point.y++;
-    }
+    const Rect explorer = pane_local(_explorer_rect);
+    widget_init(&_explorer_box, WIDGET_GROUPBOX, &_explorer_surface, RECT(POINT(0, 0), POINT(explorer.size.x + 1, explorer.size.y + 1)), _active_color);
+    widget_set_text(&_explorer_box, "Explorer");
+
+    widget_init(&_explorer_list, WIDGET_LIST, 0, RECT(POINT(1, 1), POINT(explorer.size.x - 1, explorer.size.y - 1)), _active_color);
+    list_set_items(&_explorer_list, _explorer_items, ARRAY_SIZE(_explorer_items));
+    list_set_selection(&_explorer_list, _explorer_index);
+    widget_set_focused(&_explorer_list, _explorer_selected);
+    widget_add_child(&_explorer_box, &_explorer_list);
+
+    // the console's inside is drawn from its history, not by a widget
+    const Rect console = pane_local(_console_rect);
+    widget_init(&_console_box, WIDGET_GROUPBOX, &_console_surface, RECT(POINT(0, 0), POINT(console.size.x + 1, console.size.y + 1)), _active_color);
+    widget_set_text(&_console_box, "Console");
+
+    const Rect navigator = pane_local(_navigator_rect);
+    widget_init(&_navigator_box, WIDGET_GROUPBOX, &_navigator_surface, RECT(POINT(0, 0), POINT(navigator.size.x + 1, navigator.size.y + 1)), _active_color);
+    widget_set_text(&_navigator_box, "Navigator");
+
+    widget_init(&_navigator_view, WIDGET_TEXT_VIEW, 0, RECT(POINT(1, 2), POINT(navigator.size.x - 1, navigator.size.y > 2 ? navigator.size.y - 2 : 0)), _active_color);
+    widget_add_child(&_navigator_box, &_navigator_view);
+}
+
+static void render_widgets(void)
+{
+    widget_render(&_header_label);
+    widget_render(&_footer_label);
+    widget_render(&_explorer_box);
+    widget_render(&_console_box);
+    widget_render(&_navigator_box);
+}
+
+static void render_explorer(void)
+{
+    list_set_selection(&_explorer_list, _explorer_index);
+    widget_set_focused(&_explorer_list, _explorer_selected);
+}
+
+static void show_view(WidgetAlign align, const char* text)
+{
+    widget_set_align(&_navigator_view, align);
+    widget_set_text(&_navigator_view, text);
 }
 
 void render_editor() 
 {
-    erase_rect(_navigator_rect, _active_color);
-    render_text(_navigator_rect, POINT(0, 1), _active_color, "EDITOR");
+    show_view(WIDGET_ALIGN_LEFT, "EDITOR");
 }
 
 void render_terminal()
 {
-    erase_rect(_navigator_rect, _active_color);
-    render_text_justified(_navigator_rect, POINT(0, 1), _active_color, "TERMINAL");
+    show_view(WIDGET_ALIGN_CENTER, "TERMINAL");
+
+    // everything below the title is a VT100 screen fed by the keyboard; it
+    // draws straight onto the screen, so the pane goes out first
+    widget_render(&_navigator_box);
+    surface_compose(&_navigator_surface);
+    terminal_stream_set_window(RECT(POINT(_navigator_rect.pos.x + 1, _navigator_rect.pos.y + 3),
+                                    POINT(_navigator_rect.size.x - 1, _navigator_rect.size.y - 3)), _active_color);
+    terminal_stream_writestring("\x1b[2J\x1b[1;33mstratus\x1b[0m> ");
+}
+
+static bool terminal_view_active(void)
+{
+    return !_explorer_selected && _explorer_index == 1;
+}
+
+static void terminal_view_input(const char* text)
+{
+    terminal_stream_writestring(text);
+
+    size_t x, y;
+    terminal_stream_get_cursor(&x, &y);
+    terminal_set_caret(x, y);
 }
 
 void render_settings()
 {
-    erase_rect(_navigator_rect, _active_color);
-    render_text_justified(_navigator_rect, POINT(0, 1), _active_color, "SETTINGS");
+    show_view(WIDGET_ALIGN_CENTER, "SETTINGS");
 }
 
 void render_about()
 {
-    erase_rect(_navigator_rect, _active_color);
-    render_text_justified(_navigator_rect, POINT(0, 1), _active_color, "ABOUT");
-    render_text_justified(_navigator_rect, POINT(0, 3), _active_color, COPYRIGHT_LOGO);
+    show_view(WIDGET_ALIGN_CENTER, "ABOUT\n\n" COPYRIGHT_LOGO);
 }
 
 static void render_active_view(void)
 {
+    // whatever the terminal view's stream drew went around the surface, so
+    // the next view is copied out in full
+    surface_invalidate(&_navigator_surface);
+
     switch (_explorer_index)
     {
         case 0:
@@ -322,6 +325,36 @@ static void render_active_view(void)
     }
 }
 
+static void log_active_view(void)
+{
+    char line[48] = "open ";
+    strcpy(&line[5], _explorer_items[_explorer_index]);
+    write_console(_active_color, line);
+}
+
+static void dump_stats(void)
+{
+    virtq_dump_stats(virtio_gpu_control_queue(), "gpu.ctrlq");
+    virtq_dump_stats(virtio_keyboard_event_queue(), "kbd.eventq");
+
+    TerminalFlushStats flush;
+    terminal_get_flush_stats(&flush);
+
+    printf("flush: count=%u rects=%u last_rects=%u last_bytes=%u avg_bytes=%u\n",
+           (unsigned)flush.flushes,
+           (unsigned)flush.rects,
+           (unsigned)flush.last_rects,
+           (unsigned)flush.last_bytes,
+           (unsigned)(flush.flushes ? flush.total_bytes / flush.flushes : 0));
+    printf("frames: presented=%u skipped=%u\n",
+           (unsigned)flush.frames_presented,
+           (unsigned)flush.frames_skipped);
+}
+
+// where keys typed outside the terminal view land; the caret follows it
+static size_t _type_x = 43;
+static size_t _type_y = 34;
+
 static void type_backspace(size_t* x, size_t* y)
 {
     if (!x || !y)
@@ -338,30 +371,148 @@ static void type_backspace(size_t* x, size_t* y)
     terminal_putentryat(' ', _active_color, *x, *y);
 }
 
+static void render_screen(void)
+{
+    layout_widgets();
+    render_console();
+
+    if (!_explorer_selected)
+    {
+        render_active_view();
+    }
+
+    render_widgets();
+}
+
+// the main UI lives on one head; any other enabled heads get a plain banner
+// that operators can build on
+static size_t _main_display;
+
+// one surface serves every secondary head; each is drawn and composed in
+// one go while its display is selected
+static Surface _dashboard_surface;
+static Widget _dashboard_title;
+static Widget _dashboard_box;
+
+// widgets keep their text by pointer, so each head's title has to outlive
+// the render that set it
+static char _dashboard_titles[VIRTIO_GPU_MAX_SCANOUTS][16];
+
+static void render_dashboard(size_t display)
+{
+    if (display >= VIRTIO_GPU_MAX_SCANOUTS)
+    {
+        return;
+    }
+
+    size_t cols, rows;
+    terminal_get_size(&cols, &rows);
+
+    if (!surface_init(&_dashboard_surface, RECT(POINT(0, 0), POINT(cols, rows)), _active_color))
+    {
+        return;
+    }
+
+    char* title = _dashboard_titles[display];
+    snprintf(title, sizeof(_dashboard_titles[display]), "Display %u", (unsigned)display);
+
+    widget_init(&_dashboard_title, WIDGET_LABEL, &_dashboard_surface, RECT(POINT(0, 0), POINT(cols, 1)), invert_color(_active_color));
+    widget_set_align(&_dashboard_title, WIDGET_ALIGN_CENTER);
+    widget_set_text(&_dashboard_title, title);
+
+    widget_init(&_dashboard_box, WIDGET_GROUPBOX, &_dashboard_surface, RECT(POINT(0, 1), POINT(cols, rows > 2 ? rows - 2 : 0)), _active_color);
+    widget_set_text(&_dashboard_box, "Status");
+
+    widget_render(&_dashboard_title);
+    widget_render(&_dashboard_box);
+    surface_compose(&_dashboard_surface);
+}
+
+// puts the caret back where input goes, kept on the current grid
+static void place_caret(void)
+{
+    _type_x = min(_type_x, g_term_cols ? g_term_cols - 1 : 0);
+    _type_y = min(_type_y, g_term_rows ? g_term_rows - 1 : 0);
+
+    if (terminal_view_active())
+    {
+        size_t x, y;
+        terminal_stream_get_cursor(&x, &y);
+        terminal_set_caret(x, y);
+    }
+    else
+    {
+        terminal_set_caret(_type_x, _type_y);
+    }
+}
+
+static void handle_resize(size_t display, size_t cols, size_t rows)
+{
+    if (display != _main_display)
+    {
+        render_dashboard(display);
+        return;
+    }
+
+    g_term_cols = cols;
+    g_term_rows = rows;
+    layout_init(g_term_cols, g_term_rows);
+    layout_surfaces();
+
+    render_screen();
+    compositor_compose();
+    place_caret();
+}
+
 void kernel_main(void)
 {
     printf("kernel: enter\n");
     terminal_initialize();
 
+    _main_display = terminal_selected_display();
+
+    for (size_t display = 0; display < terminal_display_count(); display++)
+    {
+        if (display != _main_display && terminal_select_display(display))
+        {
+            render_dashboard(display);
+        }
+    }
+    terminal_select_display(_main_display);
+
     terminal_get_size(&g_term_cols, &g_term_rows);
     layout_init(g_term_cols, g_term_rows);
+    layout_surfaces();
 
-    printf("kernel: terminal_initialize returned\n");
-    render_menubar();
-    terminal_flush();
+    compositor_add(&_header_surface);
+    compositor_add(&_footer_surface);
+    compositor_add(&_explorer_surface);
+    compositor_add(&_console_surface);
+    compositor_add(&_navigator_surface);
 
-    size_t x = 43;
-    size_t y = 34;
+    printf("kernel: terminal_initialize returned\n");
 
-    render_groupbox(_explorer_rect, _active_color, "Explorer", false);
-    render_groupbox(_console_rect, _active_color, "Console", false);
-    render_groupbox(_navigator_rect, _active_color, "Navigator", false);
+    if (!scrollback_init(&_console_log, CONSOLE_HISTORY_LINES, CONSOLE_HISTORY_WIDTH))
+    {
+        printf("kernel: console history unavailable\n");
+    }
 
-    render_explorer();	
+    render_screen();
+    write_console(_active_color, "Stratus ready. PgUp/PgDn browse this log.");
+    compositor_compose();
     terminal_flush();
 
+    terminal_set_resize_handler(handle_resize);
+
+    place_caret();
+    terminal_show_caret(true);
+
     while (1)
     {
+        render_widgets();
+        compositor_compose();
+        terminal_frame_tick();
+
         KeyboardEvent event;
         if (keyboard_poll_event(&event))
         {
@@ -397,6 +548,7 @@ void kernel_main(void)
                             _explorer_selected = false;
                             render_explorer();
                             render_active_view();
+                            log_active_view();
                         }
                     } break;
 
@@ -411,22 +563,56 @@ void kernel_main(void)
 
                     case KBD_KEY_ENTER:
                     {
+                        if (terminal_view_active())
+                        {
+                            terminal_view_input("\n\x1b[1;33mstratus\x1b[0m> ");
+                            break;
+                        }
+
                         if (_explorer_selected)
                         {
                             _explorer_selected = false;
                             render_explorer();
                         }
                         render_active_view();
+                        log_active_view();
+                    } break;
+
+                    case KBD_KEY_PAGEUP:
+                    {
+                        scroll_console(1);
+                    } break;
+
+                    case KBD_KEY_PAGEDOWN:
+                    {
+                        scroll_console(-1);
                     } break;
 
                     case KBD_KEY_BACKSPACE:
                     {
-                        type_backspace(&x, &y);
+                        if (terminal_view_active())
+                        {
+                            terminal_view_input("\b \b");
+                            break;
+                        }
+
+                        type_backspace(&_type_x, &_type_y);
+                        terminal_set_caret(_type_x, _type_y);
+                    } break;
+
+                    case KBD_KEY_F12:
+                    {
+                        dump_stats();
                     } break;
 
                     default:
                     {
-                        if (event.ascii)
+                        if (event.ascii && terminal_view_active())
+                        {
+                            const char text[2] = { event.ascii, '\0' };
+                            terminal_view_input(text);
+                        }
+                        else if (event.ascii)
                         {
                             if (event.ascii == 'q')
                             {
@@ -434,18 +620,23 @@ void kernel_main(void)
                             }
                             else if (event.ascii == '\b')
                             {
-                                type_backspace(&x, &y);
+                                type_backspace(&_type_x, &_type_y);
                             }
                             else
                             {
-                                terminal_putchar(event.ascii, &x, &y);
+                                terminal_putchar(event.ascii, &_type_x, &_type_y);
                             }
+
+                            terminal_set_caret(_type_x, _type_y);
                         }
                     } break;
                 }
             }
-
-            terminal_flush();
+        }
+        else if (keyboard_idle())
+        {
+            // nothing to do until the next key or the next frame
+            platform_idle_until(terminal_next_frame());
         }
     }
 }
@@ -41,6 +41,43 @@ static inline int uart_getchar_nonblock(void)
     return (int)mmio8(UART0_BASE + UART_RHR);
 }
 
+// QEMU virt PLIC; hart 0's supervisor context is context 1
+#define PLIC_BASE           ((uintptr_t)0x0C000000u)
+#define PLIC_PRIORITY(irq)  (PLIC_BASE + 4u * (irq))
+#define PLIC_ENABLE(irq)    (PLIC_BASE + 0x2080u + 4u * ((irq) / 32u))
+#define PLIC_THRESHOLD      (PLIC_BASE + 0x201000u)
+#define PLIC_CLAIM          (PLIC_BASE + 0x201004u)
+
+#define SIE_STIE (1u << 5)
+#define SIE_SEIE (1u << 9)
+#define SSTATUS_SIE (1u << 1)
+
+static inline uint32_t mmio32(uintptr_t address)
+{
+    return *(volatile uint32_t*)address;
+}
+
+static inline void mmio32_write(uintptr_t address, uint32_t v)
+{
+    *(volatile uint32_t*)address = v;
+}
+
+// SBI TIME extension; setting the timer also clears a pending timer interrupt
+#define SBI_EXT_TIME 0x54494D45u
+
+static inline void sbi_set_timer(uint64_t when)
+{
+#ifdef __GNUC__
+    register uint32_t a0 __asm__("a0") = (uint32_t)when;
+    register uint32_t a1 __asm__("a1") = (uint32_t)(when >> 32);
+    register uint32_t a6 __asm__("a6") = 0;
+    register uint32_t a7 __asm__("a7") = SBI_EXT_TIME;
+    __asm__ volatile ("ecall" : "+r"(a0), "+r"(a1) : "r"(a6), "r"(a7) : "memory");
+#else
+    (void)when;
+#endif
+}
+
 static inline void sbi_shutdown_legacy(void)
 {
 #ifdef __GNUC__
@@ -188,6 +225,73 @@ void restart(void)
     sbi_shutdown_legacy();
 }
 
+static uint64_t read_timestamp64(void)
+{
+#ifdef __GNUC__
+    uint32_t high, low, check;
+    do
+    {
+        __asm__ volatile ("rdtimeh %0" : "=r"(high));
+        __asm__ volatile ("rdtime %0" : "=r"(low));
+        __asm__ volatile ("rdtimeh %0" : "=r"(check));
+    } while (high != check);
+
+    return ((uint64_t)high << 32) | low;
+#else
+    return 0;
+#endif
+}
+
+void platform_enable_irq(uint32_t irq)
+{
+    if (irq == 0 || irq >= 1024u)
+    {
+        return;
+    }
+
+    mmio32_write(PLIC_PRIORITY(irq), 1u);
+    mmio32_write(PLIC_ENABLE(irq), mmio32(PLIC_ENABLE(irq)) | (1u << (irq % 32u)));
+    mmio32_write(PLIC_THRESHOLD, 0u);
+
+#ifdef __GNUC__
+    // wfi wakes on a locally enabled interrupt even with SIE clear, so
+    // there is no handler to install
+    __asm__ volatile ("csrc sstatus, %0" : : "r"(SSTATUS_SIE));
+    __asm__ volatile ("csrs sie, %0" : : "r"(SIE_SEIE | SIE_STIE));
+#endif
+}
+
+void platform_idle_until(uint32_t deadline)
+{
+    const uint32_t now = (uint32_t)read_timestamp();
+    if ((int32_t)(deadline - now) <= 0)
+    {
+        return;
+    }
+
+    sbi_set_timer(read_timestamp64() + (uint32_t)(deadline - now));
+
+#ifdef __GNUC__
+    __asm__ volatile ("wfi");
+#endif
+
+    // drop the timer and retire whatever woke us, once: the virtio line is
+    // level-triggered and stays asserted until its driver acknowledges the
+    // device on the next poll, so claiming again here would never run dry
+    sbi_set_timer(UINT64_MAX);
+
+    const uint32_t irq = mmio32(PLIC_CLAIM);
+    if (irq != 0)
+    {
+        mmio32_write(PLIC_CLAIM, irq);
+    }
+}
+
+bool keyboard_idle(void)
+{
+    return virtio_keyboard_idle();
+}
+
 int read_timestamp(void)
 {
 #ifdef __GNUC__
@@ -35,12 +35,28 @@ typedef struct
 #define KBD_KEY_LEFT      105u
 #define KBD_KEY_RIGHT     106u
 #define KBD_KEY_DOWN      108u
+#define KBD_KEY_PAGEUP    104u
+#define KBD_KEY_PAGEDOWN  109u
+
+#define KBD_KEY_F12       88u
+
+// QEMU virt timebase (rdtime) frequency
+#define PLATFORM_TIMER_HZ 10000000u
 
 char poll_keyboard(void);
 bool keyboard_poll_event(KeyboardEvent* out_event);
 void shut_down(void);
 void restart(void);
 int read_timestamp(void);
+
+// Routes a PLIC source to this hart so it can end platform_idle_until early.
+// Interrupts stay globally masked: they only wake the hart and are never
+// taken as traps.
+void platform_enable_irq(uint32_t irq);
+// Stops the hart until deadline (a read_timestamp value) or until an enabled
+// interrupt is pending, whichever comes first.
+void platform_idle_until(uint32_t deadline);
+bool keyboard_idle(void);
 void trap_exception_handler(uint32_t scause, uint32_t sepc, uint32_t stval);
 
 #define READ_CSR(reg)                      \
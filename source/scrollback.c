@@ -0,0 +1,114 @@
+// Stratus: scrollback.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include "scrollback.h"
+
+#include "memory.h"
+#include "utility.h"
+
+bool scrollback_init(Scrollback* scrollback, size_t lines, size_t width)
+{
+    if (!scrollback || lines == 0 || width == 0 || width > 0xffffu)
+    {
+        return false;
+    }
+
+    scrollback->text = (char*)kmalloc_aligned(lines * width, 4);
+    scrollback->lengths = (uint16_t*)kmalloc_aligned(sizeof(uint16_t) * lines, 4);
+    scrollback->colors = (uint8_t*)kmalloc_aligned(lines, 4);
+
+    if (!scrollback->text || !scrollback->lengths || !scrollback->colors)
+    {
+        printf("scrollback: alloc failed (%u lines)\n", (unsigned)lines);
+        scrollback->capacity = 0;
+        return false;
+    }
+
+    scrollback->width = width;
+    scrollback->capacity = lines;
+    scrollback->head = 0;
+    scrollback->count = 0;
+    scrollback->view = 0;
+    return true;
+}
+
+void scrollback_push(Scrollback* scrollback, const char* text, size_t length, uint8_t color)
+{
+    if (!scrollback || scrollback->capacity == 0)
+    {
+        return;
+    }
+
+    if (length > scrollback->width)
+    {
+        length = scrollback->width;
+    }
+
+    const size_t slot = scrollback->head;
+    memcpy(&scrollback->text[slot * scrollback->width], text, length);
+    scrollback->lengths[slot] = (uint16_t)length;
+    scrollback->colors[slot] = color;
+
+    scrollback->head = (slot + 1 == scrollback->capacity) ? 0 : slot + 1;
+
+    if (scrollback->count < scrollback->capacity)
+    {
+        scrollback->count++;
+    }
+
+    // keep a scrolled-back view on the lines it was showing, until they fall
+    // off the end of the ring
+    if (scrollback->view != 0 && scrollback->view + 1 < scrollback->count)
+    {
+        scrollback->view++;
+    }
+}
+
+const char* scrollback_line(const Scrollback* scrollback, size_t age, size_t* out_length, uint8_t* out_color)
+{
+    if (!scrollback || age >= scrollback->count)
+    {
+        return (const char*)0;
+    }
+
+    const size_t slot = (scrollback->head + scrollback->capacity - 1 - age) % scrollback->capacity;
+
+    if (out_length)
+    {
+        *out_length = scrollback->lengths[slot];
+    }
+    if (out_color)
+    {
+        *out_color = scrollback->colors[slot];
+    }
+
+    return &scrollback->text[slot * scrollback->width];
+}
+
+bool scrollback_scroll(Scrollback* scrollback, int32_t lines, size_t height)
+{
+    if (!scrollback)
+    {
+        return false;
+    }
+
+    const size_t limit = (scrollback->count > height) ? (scrollback->count - height) : 0;
+    size_t view = scrollback->view;
+
+    if (lines > 0)
+    {
+        view = min(view + (size_t)lines, limit);
+    }
+    else
+    {
+        view = (view > (size_t)-lines) ? (view - (size_t)-lines) : 0;
+    }
+
+    if (view == scrollback->view)
+    {
+        return false;
+    }
+
+    scrollback->view = view;
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef STRATUS_SCROLLBACK_H
+#define STRATUS_SCROLLBACK_H
+
+// Stratus: scrollback.h
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Fixed-size ring of text lines. Pushing a line and scrolling the view both
+// just move an index; memory is lines * width and never depends on the
+// screen size.
+typedef struct
+{
+    char* text;
+    uint16_t* lengths;
+    uint8_t* colors;
+
+    size_t width;
+    size_t capacity;
+
+    // slot the next line goes into, and how many slots hold lines
+    size_t head;
+    size_t count;
+
+    // how many lines the view is scrolled back from the newest one
+    size_t view;
+} Scrollback;
+
+bool scrollback_init(Scrollback* scrollback, size_t lines, size_t width);
+
+// Lines longer than the configured width are cut short. While the view is
+// scrolled back it stays on the same lines as new ones arrive.
+void scrollback_push(Scrollback* scrollback, const char* text, size_t length, uint8_t color);
+
+// age 0 is the newest line; returns null past the oldest one
+const char* scrollback_line(const Scrollback* scrollback, size_t age, size_t* out_length, uint8_t* out_color);
+
+// Moves the view by lines (positive goes back in history), keeping a full
+// page of height lines on screen; returns true if the view changed.
+bool scrollback_scroll(Scrollback* scrollback, int32_t lines, size_t height);
+
+#endif
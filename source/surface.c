@@ -0,0 +1,332 @@
+// Stratus: surface.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include "surface.h"
+
+#include "memory.h"
+#include "utility.h"
+#include "utf8.h"
+
+static Surface* _surfaces[COMPOSITOR_MAX_SURFACES];
+static size_t _surface_count;
+
+static inline TerminalCell* surface_cell(Surface* surface, size_t x, size_t y)
+{
+    return &surface->cells[y * surface->rect.size.x + x];
+}
+
+static void mark_dirty(Surface* surface, size_t y, size_t from, size_t to)
+{
+    if (surface->dirty_from[y] >= surface->dirty_to[y])
+    {
+        surface->dirty_from[y] = (uint16_t)from;
+        surface->dirty_to[y] = (uint16_t)to;
+    }
+    else
+    {
+        surface->dirty_from[y] = (uint16_t)min(surface->dirty_from[y], from);
+        surface->dirty_to[y] = (uint16_t)max(surface->dirty_to[y], to);
+    }
+
+    surface->dirty = true;
+}
+
+static inline bool set_cell(TerminalCell* cell, uint32_t codepoint, TerminalColor fg, TerminalColor bg)
+{
+    if (cell->codepoint == codepoint && cell->fg == fg && cell->bg == bg)
+    {
+        return false;
+    }
+
+    cell->codepoint = codepoint;
+    cell->fg = fg;
+    cell->bg = bg;
+    return true;
+}
+
+bool surface_init(Surface* surface, Rect rect, uint8_t color)
+{
+    if (!surface || rect.size.x == 0 || rect.size.y == 0 || rect.size.x > 0xffffu)
+    {
+        return false;
+    }
+
+    const size_t cells = rect.size.x * rect.size.y;
+    if (cells > surface->cells_capacity)
+    {
+        surface->cells = (TerminalCell*)kmalloc_aligned(sizeof(TerminalCell) * cells, 16);
+        if (!surface->cells)
+        {
+            printf("surface: cell alloc failed (%u cells)\n", (unsigned)cells);
+            surface->cells_capacity = 0;
+            return false;
+        }
+        surface->cells_capacity = cells;
+    }
+
+    if (rect.size.y > surface->rows_capacity)
+    {
+        surface->dirty_from = (uint16_t*)kmalloc_aligned(sizeof(uint16_t) * rect.size.y, 4);
+        surface->dirty_to = (uint16_t*)kmalloc_aligned(sizeof(uint16_t) * rect.size.y, 4);
+        if (!surface->dirty_from || !surface->dirty_to)
+        {
+            printf("surface: row alloc failed (%u rows)\n", (unsigned)rect.size.y);
+            surface->rows_capacity = 0;
+            surface->cells_capacity = 0;
+            surface->cells = 0;
+            return false;
+        }
+        surface->rows_capacity = rect.size.y;
+    }
+
+    surface->rect = rect;
+    surface->scroll_lines = 0;
+
+    const TerminalColor fg = terminal_attribute_fg(color);
+    const TerminalColor bg = terminal_attribute_bg(color);
+
+    for (size_t i = 0; i < cells; i++)
+    {
+        surface->cells[i] = (TerminalCell){ ' ', fg, bg };
+    }
+
+    surface_invalidate(surface);
+    return true;
+}
+
+void surface_invalidate(Surface* surface)
+{
+    if (!surface || !surface->cells)
+    {
+        return;
+    }
+
+    for (size_t y = 0; y < surface->rect.size.y; y++)
+    {
+        surface->dirty_from[y] = 0;
+        surface->dirty_to[y] = (uint16_t)surface->rect.size.x;
+    }
+
+    surface->dirty = true;
+}
+
+size_t surface_write_run(Surface* surface, size_t x, size_t y, uint8_t color, const char* data, size_t size)
+{
+    if (!surface->cells || !data || y >= surface->rect.size.y || x >= surface->rect.size.x)
+    {
+        return 0;
+    }
+
+    const TerminalColor fg = terminal_attribute_fg(color);
+    const TerminalColor bg = terminal_attribute_bg(color);
+
+    const size_t columns = surface->rect.size.x - x;
+    TerminalCell* cells = surface_cell(surface, x, y);
+
+    size_t first = columns;
+    size_t last = 0;
+
+    size_t count = 0;
+    size_t i = 0;
+    while (i < size && count < columns)
+    {
+        uint32_t codepoint = (unsigned char)data[i];
+        if (codepoint < 0x80)
+        {
+            i++;
+        }
+        else
+        {
+            i += utf8_next(&data[i], size - i, &codepoint);
+        }
+
+        if (set_cell(&cells[count], codepoint, fg, bg))
+        {
+            first = min(first, count);
+            last = count + 1;
+        }
+
+        count++;
+    }
+
+    if (first < last)
+    {
+        mark_dirty(surface, y, x + first, x + last);
+    }
+
+    return count;
+}
+
+size_t surface_fill_run(Surface* surface, size_t x, size_t y, uint8_t color, uint32_t codepoint, size_t count)
+{
+    if (!surface->cells || y >= surface->rect.size.y || x >= surface->rect.size.x)
+    {
+        return 0;
+    }
+
+    const TerminalColor fg = terminal_attribute_fg(color);
+    const TerminalColor bg = terminal_attribute_bg(color);
+
+    count = min(count, surface->rect.size.x - x);
+    TerminalCell* cells = surface_cell(surface, x, y);
+
+    size_t first = count;
+    size_t last = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (set_cell(&cells[i], codepoint, fg, bg))
+        {
+            first = min(first, i);
+            last = i + 1;
+        }
+    }
+
+    if (first < last)
+    {
+        mark_dirty(surface, y, x + first, x + last);
+    }
+
+    return count;
+}
+
+void surface_putcodepointat(Surface* surface, uint32_t codepoint, uint8_t color, size_t x, size_t y)
+{
+    surface_fill_run(surface, x, y, color, codepoint, 1);
+}
+
+void surface_scroll(Surface* surface, Rect region, int32_t lines, uint8_t fill_color)
+{
+    if (!surface->cells || lines == 0 || region.pos.x >= surface->rect.size.x || region.pos.y >= surface->rect.size.y)
+    {
+        return;
+    }
+
+    const size_t left = region.pos.x;
+    const size_t top = region.pos.y;
+    const size_t width = min(region.size.x, surface->rect.size.x - left);
+    const size_t height = min(region.size.y, surface->rect.size.y - top);
+
+    if (width == 0 || height == 0)
+    {
+        return;
+    }
+
+    region.size = POINT(width, height);
+
+    const bool up = lines > 0;
+    const size_t shift = min(up ? (size_t)lines : (size_t)-lines, height);
+    const size_t kept = height - shift;
+
+    // a row that moves takes its changed columns along, so what was pending
+    // before the scroll still gets copied once the screen has scrolled too
+    for (size_t i = 0; i < kept; i++)
+    {
+        const size_t y = up ? (top + i) : (top + height - 1 - i);
+        const size_t from = up ? (y + shift) : (y - shift);
+
+        memmove(surface_cell(surface, left, y), surface_cell(surface, left, from), sizeof(TerminalCell) * width);
+
+        if (surface->dirty_from[from] < surface->dirty_to[from])
+        {
+            mark_dirty(surface, y, surface->dirty_from[from], surface->dirty_to[from]);
+        }
+    }
+
+    const TerminalColor fg = terminal_attribute_fg(fill_color);
+    const TerminalColor bg = terminal_attribute_bg(fill_color);
+
+    const size_t exposed_top = up ? (top + kept) : top;
+    for (size_t y = exposed_top; y < exposed_top + shift; y++)
+    {
+        TerminalCell* cells = surface_cell(surface, left, y);
+        for (size_t x = 0; x < width; x++)
+        {
+            cells[x] = (TerminalCell){ ' ', fg, bg };
+        }
+
+        mark_dirty(surface, y, left, left + width);
+    }
+
+    // Repeated scrolls of one region add up into a single screen scroll. A
+    // different region cannot join the pending one, so it is copied instead.
+    const Rect pending = surface->scroll_region;
+    const bool same = pending.pos.x == region.pos.x && pending.pos.y == region.pos.y &&
+                      pending.size.x == region.size.x && pending.size.y == region.size.y;
+
+    if (surface->scroll_lines == 0 || same)
+    {
+        surface->scroll_region = region;
+        surface->scroll_lines += lines;
+        surface->scroll_color = fill_color;
+    }
+    else
+    {
+        for (size_t y = top; y < top + height; y++)
+        {
+            mark_dirty(surface, y, left, left + width);
+        }
+    }
+
+    surface->dirty = true;
+}
+
+void surface_compose(Surface* surface)
+{
+    if (!surface->cells || !surface->dirty)
+    {
+        return;
+    }
+
+    const Point origin = surface->rect.pos;
+
+    if (surface->scroll_lines != 0)
+    {
+        const Rect region = surface->scroll_region;
+        terminal_scroll_region(RECT(POINT(origin.x + region.pos.x, origin.y + region.pos.y), region.size),
+                               surface->scroll_lines, surface->scroll_color);
+        surface->scroll_lines = 0;
+    }
+
+    for (size_t y = 0; y < surface->rect.size.y; y++)
+    {
+        const size_t from = surface->dirty_from[y];
+        const size_t to = surface->dirty_to[y];
+
+        if (from < to)
+        {
+            terminal_put_cells(origin.x + from, origin.y + y, surface_cell(surface, from, y), to - from);
+            surface->dirty_from[y] = 0;
+            surface->dirty_to[y] = 0;
+        }
+    }
+
+    surface->dirty = false;
+}
+
+bool compositor_add(Surface* surface)
+{
+    for (size_t i = 0; i < _surface_count; i++)
+    {
+        if (_surfaces[i] == surface)
+        {
+            return true;
+        }
+    }
+
+    if (_surface_count == COMPOSITOR_MAX_SURFACES)
+    {
+        return false;
+    }
+
+    _surfaces[_surface_count++] = surface;
+    return true;
+}
+
+void compositor_compose(void)
+{
+    for (size_t i = 0; i < _surface_count; i++)
+    {
+        surface_compose(_surfaces[i]);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef STRATUS_SURFACE_H
+#define STRATUS_SURFACE_H
+
+// Stratus: surface.h
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "defs.h"
+#include "fb_console.h"
+
+// Off-screen grid of cells for one pane. Drawing uses surface coordinates
+// and is clipped to the surface, so a pane can never spill into its
+// neighbours. Each row remembers the span of columns that changed, and
+// composing copies just those spans onto the screen.
+typedef struct
+{
+    // where the surface sits on screen, in cells
+    Rect rect;
+
+    TerminalCell* cells;
+    size_t cells_capacity;
+
+    // changed columns of each row, as [from, to)
+    uint16_t* dirty_from;
+    uint16_t* dirty_to;
+    size_t rows_capacity;
+    bool dirty;
+
+    // a scroll not yet applied to the screen; the screen's pixels are moved
+    // in bulk instead of the whole region being copied again
+    Rect scroll_region;
+    int32_t scroll_lines;
+    uint8_t scroll_color;
+} Surface;
+
+#define COMPOSITOR_MAX_SURFACES 8u
+
+// Places the surface and clears it to blanks in color, all of it dirty.
+// Buffers are only reallocated when they need to grow.
+bool surface_init(Surface* surface, Rect rect, uint8_t color);
+
+// Marks every cell changed, for when something else drew over the surface's
+// part of the screen.
+void surface_invalidate(Surface* surface);
+
+// Same as the terminal run calls, in surface coordinates: data is UTF-8 and
+// the return value is how many cells were written.
+size_t surface_write_run(Surface* surface, size_t x, size_t y, uint8_t color, const char* data, size_t size);
+size_t surface_fill_run(Surface* surface, size_t x, size_t y, uint8_t color, uint32_t codepoint, size_t count);
+void surface_putcodepointat(Surface* surface, uint32_t codepoint, uint8_t color, size_t x, size_t y);
+
+// Scrolls the cells inside region by lines rows (positive moves content up)
+// and clears the exposed rows to fill_color.
+void surface_scroll(Surface* surface, Rect region, int32_t lines, uint8_t fill_color);
+
+// Brings the surface's part of the screen up to date.
+void surface_compose(Surface* surface);
+
+// Surfaces composed by compositor_compose, in the order they were added;
+// later ones land on top where they overlap.
+bool compositor_add(Surface* surface);
+void compositor_compose(void);
+
+#endif
@@ -0,0 +1,84 @@
+// Stratus: utf8.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include "utf8.h"
+
+Utf8Status utf8_decode(Utf8Decoder* decoder, uint8_t byte, uint32_t* out_codepoint)
+{
+    if (decoder->remaining == 0)
+    {
+        if (byte < 0x80u)
+        {
+            *out_codepoint = byte;
+            return UTF8_DONE;
+        }
+
+        if (byte >= 0xC2u && byte <= 0xDFu)
+        {
+            decoder->codepoint = byte & 0x1Fu;
+            decoder->minimum = 0x80u;
+            decoder->remaining = 1;
+        }
+        else if (byte >= 0xE0u && byte <= 0xEFu)
+        {
+            decoder->codepoint = byte & 0x0Fu;
+            decoder->minimum = 0x800u;
+            decoder->remaining = 2;
+        }
+        else if (byte >= 0xF0u && byte <= 0xF4u)
+        {
+            decoder->codepoint = byte & 0x07u;
+            decoder->minimum = 0x10000u;
+            decoder->remaining = 3;
+        }
+        else
+        {
+            // stray continuation byte or a lead that can never be valid
+            *out_codepoint = UTF8_REPLACEMENT;
+            return UTF8_DONE;
+        }
+
+        return UTF8_PENDING;
+    }
+
+    if ((byte & 0xC0u) != 0x80u)
+    {
+        decoder->remaining = 0;
+        *out_codepoint = UTF8_REPLACEMENT;
+        return UTF8_RETRY;
+    }
+
+    decoder->codepoint = (decoder->codepoint << 6) | (byte & 0x3Fu);
+    if (--decoder->remaining > 0)
+    {
+        return UTF8_PENDING;
+    }
+
+    const uint32_t codepoint = decoder->codepoint;
+    const bool surrogate = codepoint >= 0xD800u && codepoint <= 0xDFFFu;
+
+    *out_codepoint = (codepoint < decoder->minimum || codepoint > 0x10FFFFu || surrogate) ? UTF8_REPLACEMENT : codepoint;
+    return UTF8_DONE;
+}
+
+size_t utf8_next(const char* data, size_t size, uint32_t* out_codepoint)
+{
+    Utf8Decoder decoder = { 0 };
+
+    for (size_t i = 0; i < size; i++)
+    {
+        switch (utf8_decode(&decoder, (uint8_t)data[i], out_codepoint))
+        {
+            case UTF8_DONE:
+                return i + 1;
+            case UTF8_RETRY:
+                return i;
+            case UTF8_PENDING:
+            default:
+                break;
+        }
+    }
+
+    *out_codepoint = UTF8_REPLACEMENT;
+    return size;
+}
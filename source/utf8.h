@@ -0,0 +1,40 @@
+#ifndef STRATUS_UTF8_H
+#define STRATUS_UTF8_H
+
+// Stratus: utf8.h
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define UTF8_REPLACEMENT 0xFFFDu
+
+// Incremental decoder state; zero-initialize before the first byte. A
+// sequence may be split across any number of calls.
+typedef struct
+{
+    uint32_t codepoint;
+    uint32_t minimum;
+    uint8_t remaining;
+} Utf8Decoder;
+
+typedef enum
+{
+    UTF8_PENDING,
+    UTF8_DONE,
+    UTF8_RETRY,
+} Utf8Status;
+
+// Feeds one byte. UTF8_DONE hands back a codepoint, U+FFFD for a malformed
+// byte or an overlong, surrogate or out of range sequence. UTF8_RETRY also
+// hands back U+FFFD, for a sequence cut short by this byte, which then has
+// to be fed again.
+Utf8Status utf8_decode(Utf8Decoder* decoder, uint8_t byte, uint32_t* out_codepoint);
+
+// Decodes the codepoint at the front of a complete buffer and returns how
+// many bytes it used; a sequence truncated by the end of the buffer comes
+// back as U+FFFD.
+size_t utf8_next(const char* data, size_t size, uint32_t* out_codepoint);
+
+#endif
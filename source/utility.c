@@ -92,6 +92,57 @@ void* memcpy(void* destination, const void* source, size_t number)
     return destination;
 }
 
+void* memmove(void* destination, const void* source, size_t number)
+{
+    uint8_t* d = (uint8_t*)destination;
+    const uint8_t* s = (const uint8_t*)source;
+
+    if (d == s || number == 0)
+    {
+        return destination;
+    }
+
+    // whole words when everything lines up, which covers pixel rows
+    const bool words = (((uintptr_t)d | (uintptr_t)s | number) & 3u) == 0;
+
+    if (d < s)
+    {
+        if (words)
+        {
+            uint32_t* dw = (uint32_t*)d;
+            const uint32_t* sw = (const uint32_t*)s;
+            for (size_t i = 0; i < number / 4u; i++)
+            {
+                dw[i] = sw[i];
+            }
+            return destination;
+        }
+
+        while (number--)
+        {
+            *d++ = *s++;
+        }
+        return destination;
+    }
+
+    if (words)
+    {
+        uint32_t* dw = (uint32_t*)d;
+        const uint32_t* sw = (const uint32_t*)s;
+        for (size_t i = number / 4u; i-- > 0;)
+        {
+            dw[i] = sw[i];
+        }
+        return destination;
+    }
+
+    while (number--)
+    {
+        d[number] = s[number];
+    }
+    return destination;
+}
+
 void putchar(char c)
 {
     if (c == '\n')
@@ -102,11 +153,32 @@ void putchar(char c)
     platform_putchar(c);
 }
 
-void printf(const char* format, ...)
+// where formatted output goes: the console when out is null, otherwise a
+// buffer that keeps counting past its end like snprintf does
+typedef struct
 {
-    va_list va;
-    va_start(va, format);
+    char* out;
+    size_t size;
+    size_t length;
+} FormatSink;
+
+static void format_emit(FormatSink* sink, char c)
+{
+    if (!sink->out)
+    {
+        putchar(c);
+        return;
+    }
 
+    if (sink->length + 1 < sink->size)
+    {
+        sink->out[sink->length] = c;
+    }
+    sink->length++;
+}
+
+static void format_to(FormatSink* sink, const char* format, va_list va)
+{
     while (*format)
     {
         if (*format == '%')
@@ -118,7 +190,7 @@ void printf(const char* format, ...)
                 case 'c':
                 {
                     char c = (char)va_arg(va, int);
-                    putchar(c);
+                    format_emit(sink, c);
                     break;
                 }
                 case 's':
@@ -126,7 +198,7 @@ void printf(const char* format, ...)
                     const char* str = va_arg(va, const char*);
                     while (*str)
                     {
-                        putchar(*str++);
+                        format_emit(sink, *str++);
                     }
                     break;
                 }
@@ -156,7 +228,7 @@ void printf(const char* format, ...)
 
                     while (i--)
                     {
-                        putchar(buffer[i]);
+                        format_emit(sink, buffer[i]);
                     }
 
                     break;
@@ -175,7 +247,7 @@ void printf(const char* format, ...)
 
                     while (i--)
                     {
-                        putchar(buffer[i]);
+                        format_emit(sink, buffer[i]);
                     }
 
                     break;
@@ -186,19 +258,19 @@ void printf(const char* format, ...)
                     for (int i = (sizeof(unsigned int) * 2) - 1; i >= 0; i--)
                     {
                         unsigned char nibble = (number >> (i * 4)) & 0xF;
-                        putchar("0123456789ABCDEF"[nibble]);
+                        format_emit(sink, "0123456789ABCDEF"[nibble]);
                     }
 
                     break;
                 }
                 case '%':
                 {
-                    putchar('%');
+                    format_emit(sink, '%');
                     break;
                 }
                 case '\0':
                 {
-                    putchar('%');
+                    format_emit(sink, '%');
                     goto done;
                 }
                 default:
@@ -207,13 +279,40 @@ void printf(const char* format, ...)
         }
         else
         {
-            putchar(*format);
+            format_emit(sink, *format);
         }
 
         format++;
     }
 
     done:
-        va_end(va);
+        return;
+}
+
+void printf(const char* format, ...)
+{
+    FormatSink sink = { 0, 0, 0 };
+
+    va_list va;
+    va_start(va, format);
+    format_to(&sink, format, va);
+    va_end(va);
+}
+
+size_t snprintf(char* out, size_t size, const char* format, ...)
+{
+    FormatSink sink = { out, size, 0 };
+
+    va_list va;
+    va_start(va, format);
+    format_to(&sink, format, va);
+    va_end(va);
+
+    if (size != 0)
+    {
+        out[min(sink.length, size - 1)] = '\0';
+    }
+
+    return sink.length;
 }
 
@@ -14,8 +14,12 @@ char* strcpy(char* out, const char* str);
 int strcmp(const char* string1, const char* string2);
 void* memset(void* pointer, unsigned char value, size_t number);
 void* memcpy(void* destination, const void* source, size_t number);
+void* memmove(void* destination, const void* source, size_t number);
 
 void putchar(char c);
 void printf(const char* format, ...);
+// Same formats as printf; always terminates out when size is nonzero and
+// returns the length the whole string would have had.
+size_t snprintf(char* out, size_t size, const char* format, ...);
 
 #endif
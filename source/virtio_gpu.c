@@ -17,10 +17,44 @@
 #define VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D   0x0105u
 #define VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING 0x0106u
 #define VIRTIO_GPU_CMD_RESOURCE_DETACH_BACKING 0x0107u
+#define VIRTIO_GPU_CMD_RESOURCE_CREATE_BLOB  0x010cu
+#define VIRTIO_GPU_CMD_SET_SCANOUT_BLOB      0x010du
+
+#define VIRTIO_GPU_CMD_UPDATE_CURSOR         0x0300u
+#define VIRTIO_GPU_CMD_MOVE_CURSOR           0x0301u
 
 #define VIRTIO_GPU_RESP_OK_NODATA            0x1100u
 #define VIRTIO_GPU_RESP_OK_DISPLAY_INFO      0x1101u
+#define VIRTIO_GPU_RESP_ERR_UNSPEC           0x1200u
+
+#define GPU_CONTROL_QUEUE_SIZE 64u
+#define GPU_CURSOR_QUEUE_SIZE 16u
+
+// the host only accepts 64x64 cursor images
+#define GPU_CURSOR_SIZE 64u
+
+// every scanout owns a pair of resources; the cursor image comes after them
+#define GPU_SCANOUT_RESOURCE_ID(scanout, buffer) (1u + (scanout) * 2u + (buffer))
+#define GPU_CURSOR_RESOURCE_ID (1u + VIRTIO_GPU_MAX_SCANOUTS * 2u)
+
+// framebuffer backings are built from fixed-size chunks instead of one
+// multi-megabyte block; the chunks outlive a resize and are reused
+#define GPU_BACKING_CHUNK_BYTES (64u * 1024u)
+
+#define VIRTIO_GPU_FLAG_FENCE                1u
+
+#define VIRTIO_GPU_F_RESOURCE_BLOB           3u
+#define VIRTIO_GPU_BLOB_MEM_GUEST            1u
+
+// device config space: events_read, events_clear, num_scanouts, num_capsets
+#define VIRTIO_MMIO_CONFIG                   0x100u
+#define VIRTIO_GPU_CONFIG_EVENTS_READ        (VIRTIO_MMIO_CONFIG + 0x0u)
+#define VIRTIO_GPU_CONFIG_EVENTS_CLEAR       (VIRTIO_MMIO_CONFIG + 0x4u)
+#define VIRTIO_GPU_CONFIG_NUM_SCANOUTS       (VIRTIO_MMIO_CONFIG + 0x8u)
 
+#define VIRTIO_GPU_EVENT_DISPLAY             1u
+
+#define VIRTIO_GPU_FORMAT_B8G8R8A8_UNORM     1u
 #define VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM     2u
 
 typedef struct PACKED
@@ -55,7 +89,7 @@ typedef struct PACKED
 typedef struct PACKED
 {
     VgCommandHeader header;
-    VgDisplayInstance pmodes[16];
+    VgDisplayInstance pmodes[VIRTIO_GPU_MAX_SCANOUTS];
 } VgResponseDisplayInfo;
 
 typedef struct PACKED
@@ -111,14 +145,140 @@ typedef struct PACKED
     VgCommandHeader header;
 } VgResponseHeaderOnly;
 
+// guest memory blob; followed by nr_entries VgMemoryEntry records
+typedef struct PACKED
+{
+    VgCommandHeader header;
+    uint32_t resource_id;
+    uint32_t blob_mem;
+    uint32_t blob_flags;
+    uint32_t nr_entries;
+    uint64_t blob_id;
+    uint64_t size;
+} VgCreateBlob;
+
+typedef struct PACKED
+{
+    VgCommandHeader header;
+    VgRect rect;
+    uint32_t scanout_id;
+    uint32_t resource_id;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t padding;
+    uint32_t strides[4];
+    uint32_t offsets[4];
+} VgScanoutBlob;
+
+// RESOURCE_UNREF and RESOURCE_DETACH_BACKING
+typedef struct PACKED
+{
+    VgCommandHeader header;
+    uint32_t resource_id;
+    uint32_t padding;
+} VgResourceReference;
+
+typedef struct PACKED
+{
+    uint32_t scanout_id;
+    uint32_t x;
+    uint32_t y;
+    uint32_t padding;
+} VgCursorPosition;
+
+typedef struct PACKED
+{
+    VgCommandHeader header;
+    VgCursorPosition position;
+    uint32_t resource_id;
+    uint32_t hot_x;
+    uint32_t hot_y;
+    uint32_t padding;
+} VgUpdateCursor;
+
+// Two resources with separate backings: rendering goes to the back buffer
+// while the host scans out the front one, and presenting flips them.
+typedef struct
+{
+    uint32_t resource_id;
+
+    // the backing is a list of separately allocated chunks of whole rows, so
+    // pixels are only reachable through the row table
+    uint32_t** rows;
+    uint32_t rows_capacity;
+
+    // the same entries are kept behind both message headers, so either kind
+    // of resource can be created from them
+    VgAttachBacking* backing;
+    VgCreateBlob* blob;
+    uint32_t entry_count;
+    uint32_t entries_capacity;
+
+    uint8_t** chunks;
+    uint32_t chunk_count;
+    uint32_t chunks_capacity;
+
+    // fence on the last transfer that read this backing
+    uint64_t last_read;
+
+    // rects the copy-forward brought up to date in guest memory that the
+    // host resource has not seen yet; they go out with the buffer's next
+    // present (2D resources only)
+    VgRect unsent[VIRTIO_GPU_MAX_PRESENT_RECTS];
+    uint32_t unsent_count;
+} GpuScanoutBuffer;
+
+// one per enabled display head, indexed by scanout id
+typedef struct
+{
+    bool active;
+    // blob heads are scanned out straight from guest memory and never need
+    // a transfer
+    bool blob;
+    FramebufferInfo framebuffer;
+    GpuScanoutBuffer buffers[2];
+    uint32_t back;
+
+    // the last present's damage, still to be copied from the front buffer
+    // into the back one; held until the back buffer is first written so the
+    // wait for the host to let go of it overlaps with the next frame
+    VgRect carry[VIRTIO_GPU_MAX_PRESENT_RECTS];
+    uint32_t carry_count;
+} GpuScanout;
+
 static ViMMIODevice _device;
 static ViQueue _control_queue;
-static FramebufferInfo _framebuffer;
-static uint32_t _resource_id = 1;
+static bool _ready;
+static bool _blob_supported;
+static GpuScanout _scanouts[VIRTIO_GPU_MAX_SCANOUTS];
+static uint32_t _scanout_count;
+
+// cursorq commands carry no response; each in-flight one lives in the slot
+// indexed by its descriptor
+static ViQueue _cursor_queue;
+static bool _cursor_ok;
+static bool _cursor_visible;
+static uint32_t _cursor_scanout;
+static uint32_t* _cursor_pixels;
+static uint32_t _cursor_x, _cursor_y;
+static uint32_t _cursor_hot_x, _cursor_hot_y;
+static VgUpdateCursor _cursor_commands[GPU_CURSOR_QUEUE_SIZE];
+
+// fenced commands complete in submission order; the device holds back their
+// response until the fence has signalled
+static uint64_t _fence_next = 1;
+static uint64_t _fence_completed;
+static uint64_t _present_fence;
 
 static inline void fence_iorw(void)
 {
+#if defined(__riscv)
     __asm__ volatile ("fence iorw, iorw" : : : "memory");
+#else
+    // host builds under tools/host
+    __sync_synchronize();
+#endif
 }
 
 static inline uint32_t mmio_read32(uintptr_t base, uint32_t off)
@@ -151,16 +311,157 @@ static void gpu_hdr_init(VgCommandHeader* header, uint32_t type)
     header->padding = 0;
 }
 
-static bool gpu_send_cmd(void* request, uint32_t req_len, void* response, uint32_t resp_len)
+static uint64_t gpu_hdr_fence(VgCommandHeader* header)
+{
+    header->flags |= VIRTIO_GPU_FLAG_FENCE;
+    header->fence_id = _fence_next++;
+    return header->fence_id;
+}
+
+// Control queue command stream. Every in-flight command owns the slot indexed
+// by its head descriptor, which carries preallocated request and response
+// storage so callers can enqueue without waiting for the device.
+typedef struct
+{
+    bool busy;
+    uint32_t sequence;
+    uint32_t command;
+    uint64_t fence_id;
+    VgResponseHeaderOnly* response;
+
+    union
+    {
+        VgCommandHeader header;
+        VgTransferToHost transfer;
+        VgResourceFlush flush;
+        VgScanoutInfo scanout;
+        VgScanoutBlob scanout_blob;
+    } request;
+
+    VgResponseHeaderOnly response_storage;
+} GpuCommandSlot;
+
+static GpuCommandSlot _slots[GPU_CONTROL_QUEUE_SIZE];
+static uint32_t _next_sequence = 1;
+static uint32_t _unnotified;
+static uint32_t _command_errors;
+
+// response type of recently completed commands, indexed by sequence; a slot
+// is overwritten once the sequence number comes around again
+#define GPU_RESULT_HISTORY 256u
+
+typedef struct
+{
+    uint32_t sequence;
+    uint32_t response;
+} GpuCommandResult;
+
+static GpuCommandResult _results[GPU_RESULT_HISTORY];
+
+static bool gpu_response_ok(uint32_t type)
+{
+    return type >= VIRTIO_GPU_RESP_OK_NODATA && type < VIRTIO_GPU_RESP_ERR_UNSPEC;
+}
+
+static void gpu_reap(void)
+{
+    uint16_t head;
+    while (virtq_poll_used(&_control_queue, &head))
+    {
+        if (head >= GPU_CONTROL_QUEUE_SIZE || !_slots[head].busy)
+        {
+            continue;
+        }
+
+        GpuCommandSlot* slot = &_slots[head];
+
+        const uint32_t type = slot->response->header.type;
+
+        GpuCommandResult* result = &_results[slot->sequence % GPU_RESULT_HISTORY];
+        result->sequence = slot->sequence;
+        result->response = type;
+
+        if (!gpu_response_ok(type))
+        {
+            _command_errors++;
+            printf("virtio-gpu: cmd 0x%x (seq %u) failed response=0x%x\n",
+                   (unsigned)slot->command, (unsigned)slot->sequence, (unsigned)type);
+        }
+
+        if (slot->fence_id > _fence_completed)
+        {
+            _fence_completed = slot->fence_id;
+        }
+
+        slot->busy = false;
+        virtq_free_chain(&_control_queue, head);
+    }
+}
+
+static void gpu_kick(void)
 {
+    if (_unnotified == 0)
+    {
+        return;
+    }
+
+    _unnotified = 0;
+    virtq_notify(&_control_queue);
+}
+
+static GpuCommandSlot* gpu_slot_reserve(void)
+{
+    gpu_reap();
+
     int head = virtq_alloc_chain(&_control_queue, 2);
     if (head < 0)
     {
-        return false;
+        // ring is full of in-flight commands; push them out and wait for
+        // room without retrying the allocation, so the stall counts as a
+        // single ring-full
+        gpu_kick();
+
+        uint32_t spin = 0;
+        while (_control_queue.number_free < 2)
+        {
+            if (++spin == 10000000u)
+            {
+                printf("virtio-gpu: ctrlq full\n");
+                return (GpuCommandSlot*)0;
+            }
+
+            gpu_reap();
+        }
+
+        head = virtq_alloc_chain(&_control_queue, 2);
+        if (head < 0)
+        {
+            return (GpuCommandSlot*)0;
+        }
     }
 
-    uint16_t d0 = (uint16_t)head;
-    uint16_t d1 = _control_queue.descriptor[d0].next;
+    GpuCommandSlot* slot = &_slots[head];
+    slot->busy = true;
+    slot->sequence = 0;
+    return slot;
+}
+
+static uint32_t gpu_slot_submit(GpuCommandSlot* slot, const void* request, uint32_t req_len, void* response, uint32_t resp_len)
+{
+    const uint16_t d0 = (uint16_t)(slot - _slots);
+    const uint16_t d1 = _control_queue.descriptor[d0].next;
+
+    zero_bytes(response, resp_len);
+
+    slot->sequence = _next_sequence++;
+    if (_next_sequence == 0)
+    {
+        _next_sequence = 1;
+    }
+    const VgCommandHeader* header = (const VgCommandHeader*)request;
+    slot->command = header->type;
+    slot->fence_id = (header->flags & VIRTIO_GPU_FLAG_FENCE) ? header->fence_id : 0;
+    slot->response = (VgResponseHeaderOnly*)response;
 
     _control_queue.descriptor[d0].address = (uint64_t)(uintptr_t)request;
     _control_queue.descriptor[d0].length = req_len;
@@ -169,27 +470,109 @@ static bool gpu_send_cmd(void* request, uint32_t req_len, void* response, uint32
     _control_queue.descriptor[d1].length = resp_len;
     _control_queue.descriptor[d1].flags = (uint16_t)(_control_queue.descriptor[d1].flags | VIRTQ_DESC_F_WRITE);
 
-    virtq_submit(&_control_queue, (uint16_t)head);
-    virtio_mmio_notify_queue(&_device, 0);
+    virtq_submit(&_control_queue, d0);
+    _unnotified++;
+
+    return slot->sequence;
+}
+
+static bool gpu_sequence_pending(uint32_t sequence)
+{
+    for (size_t i = 0; i < GPU_CONTROL_QUEUE_SIZE; i++)
+    {
+        if (_slots[i].busy && (sequence == 0 || (int32_t)(_slots[i].sequence - sequence) <= 0))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static VirtioGpuResult gpu_result(uint32_t sequence)
+{
+    if (sequence == 0)
+    {
+        return VIRTIO_GPU_RESULT_UNKNOWN;
+    }
+
+    for (size_t i = 0; i < GPU_CONTROL_QUEUE_SIZE; i++)
+    {
+        if (_slots[i].busy && _slots[i].sequence == sequence)
+        {
+            return VIRTIO_GPU_RESULT_PENDING;
+        }
+    }
+
+    const GpuCommandResult* result = &_results[sequence % GPU_RESULT_HISTORY];
+    if (result->sequence != sequence)
+    {
+        return VIRTIO_GPU_RESULT_UNKNOWN;
+    }
+
+    return gpu_response_ok(result->response) ? VIRTIO_GPU_RESULT_OK : VIRTIO_GPU_RESULT_FAILED;
+}
+
+static bool gpu_wait(uint32_t sequence)
+{
+    gpu_kick();
+
+    uint32_t spin = 0;
+    for (;;)
+    {
+        gpu_reap();
+
+        if (!gpu_sequence_pending(sequence))
+        {
+            return gpu_result(sequence) != VIRTIO_GPU_RESULT_FAILED;
+        }
+
+        if (++spin == 10000000u)
+        {
+            printf("virtio-gpu: ctrlq timeout (seq %u)\n", (unsigned)sequence);
+            return false;
+        }
+    }
+}
+
+static bool gpu_fence_wait(uint64_t fence_id)
+{
+    if (fence_id >= _fence_next)
+    {
+        return false;
+    }
+
+    gpu_kick();
 
-    uint16_t used_id;
     uint32_t spin = 0;
-    while (!virtq_poll_used(&_control_queue, &used_id))
+    while (_fence_completed < fence_id)
     {
         if (++spin == 10000000u)
         {
-            printf("virtio-gpu: ctrlq timeout\n");
-            virtq_free_chain(&_control_queue, (uint16_t)head);
+            printf("virtio-gpu: fence %u timeout\n", (unsigned)fence_id);
             return false;
         }
+
+        gpu_reap();
     }
 
-    (void)used_id;
-    virtq_free_chain(&_control_queue, (uint16_t)head);
     return true;
 }
 
-static bool gpu_get_display(uint32_t* out_w, uint32_t* out_h)
+static bool gpu_send_cmd(void* request, uint32_t req_len, void* response, uint32_t resp_len)
+{
+    GpuCommandSlot* slot = gpu_slot_reserve();
+    if (!slot)
+    {
+        return false;
+    }
+
+    const uint32_t sequence = gpu_slot_submit(slot, request, req_len, response, resp_len);
+    return gpu_wait(sequence);
+}
+
+// fills one rect per scanout; disabled heads come back zero-sized
+static bool gpu_get_display(VgRect* out_modes)
 {
     VgDisplayInfo request;
     VgResponseDisplayInfo response;
@@ -207,24 +590,27 @@ static bool gpu_get_display(uint32_t* out_w, uint32_t* out_h)
         return false;
     }
 
-    if (!response.pmodes[0].enabled)
+    for (uint32_t i = 0; i < VIRTIO_GPU_MAX_SCANOUTS; i++)
     {
-        return false;
+        const bool usable = i < _scanout_count && response.pmodes[i].enabled;
+
+        out_modes[i].x = 0;
+        out_modes[i].y = 0;
+        out_modes[i].width = usable ? response.pmodes[i].rect.width : 0;
+        out_modes[i].height = usable ? response.pmodes[i].rect.height : 0;
     }
 
-    *out_w = response.pmodes[0].rect.width;
-    *out_h = response.pmodes[0].rect.height;
     return true;
 }
 
-static bool gpu_create_resource(uint32_t width, uint32_t height)
+static bool gpu_create_resource(uint32_t resource_id, uint32_t format, uint32_t width, uint32_t height)
 {
     VgCreateTexture request;
     VgResponseHeaderOnly response;
 
     gpu_hdr_init(&request.header, VIRTIO_GPU_CMD_RESOURCE_CREATE_2D);
-    request.resource_id = _resource_id;
-    request.format = VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM;
+    request.resource_id = resource_id;
+    request.format = format;
     request.width = width;
     request.height = height;
 
@@ -238,28 +624,20 @@ static bool gpu_create_resource(uint32_t width, uint32_t height)
     return response.header.type == VIRTIO_GPU_RESP_OK_NODATA;
 }
 
-static bool gpu_attach_backing(void* buffer, uint32_t framebuffer_bytes)
+// message must be followed in memory by entry_count VgMemoryEntry records
+static bool gpu_attach_backing(uint32_t resource_id, VgAttachBacking* message, uint32_t entry_count)
 {
-    typedef struct PACKED
-    {
-        VgAttachBacking request;
-        VgMemoryEntry entry;
-    } VgAttachBackingMessage;
-
-    VgAttachBackingMessage message;
     VgResponseHeaderOnly response;
 
-    gpu_hdr_init(&message.request.header, VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING);
-    message.request.resource_id = _resource_id;
-    message.request.entry_count = 1;
+    gpu_hdr_init(&message->header, VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING);
+    message->resource_id = resource_id;
+    message->entry_count = entry_count;
 
-    message.entry.address = (uint64_t)(uintptr_t)buffer;
-    message.entry.length = framebuffer_bytes;
-    message.entry.padding = 0;
+    const uint32_t length = (uint32_t)(sizeof(VgAttachBacking) + sizeof(VgMemoryEntry) * entry_count);
 
     zero_bytes(&response, sizeof(response));
 
-    if (!gpu_send_cmd(&message, sizeof(message), &response, sizeof(response)))
+    if (!gpu_send_cmd(message, length, &response, sizeof(response)))
     {
         return false;
     }
@@ -267,90 +645,108 @@ static bool gpu_attach_backing(void* buffer, uint32_t framebuffer_bytes)
     return response.header.type == VIRTIO_GPU_RESP_OK_NODATA;
 }
 
-static bool gpu_set_scanout(uint32_t width, uint32_t height)
+static bool gpu_alloc_backing(GpuScanoutBuffer* buffer, uint32_t stride, uint32_t height)
 {
-    VgScanoutInfo request;
-    VgResponseHeaderOnly response;
-
-    gpu_hdr_init(&request.header, VIRTIO_GPU_CMD_SET_SCANOUT);
-    request.rect.x = 0;
-    request.rect.y = 0;
-    request.rect.width = width;
-    request.rect.height = height;
-    request.scanout_id = 0;
-    request.resource_id = _resource_id;
-
-    zero_bytes(&response, sizeof(response));
-
-    if (!gpu_send_cmd(&request, sizeof(request), &response, sizeof(response)))
+    const uint32_t rows_per_chunk = GPU_BACKING_CHUNK_BYTES / stride;
+    if (rows_per_chunk == 0)
     {
         return false;
     }
 
-    if (response.header.type != VIRTIO_GPU_RESP_OK_NODATA)
+    const uint32_t needed = (height + rows_per_chunk - 1) / rows_per_chunk;
+
+    // bookkeeping only ever grows; the old arrays are simply abandoned
+    if (height > buffer->rows_capacity)
     {
-        printf("virtio-gpu: set_scanout response=0x%x\n", (unsigned)response.header.type);
-        return false;
+        buffer->rows = (uint32_t**)kmalloc_aligned(sizeof(uint32_t*) * height, 4);
+        buffer->rows_capacity = buffer->rows ? height : 0;
     }
 
-    return true;
-}
+    if (needed > buffer->entries_capacity)
+    {
+        buffer->backing = (VgAttachBacking*)kmalloc_aligned(sizeof(VgAttachBacking) + sizeof(VgMemoryEntry) * needed, 8);
+        buffer->blob = _blob_supported ? (VgCreateBlob*)kmalloc_aligned(sizeof(VgCreateBlob) + sizeof(VgMemoryEntry) * needed, 8) : (VgCreateBlob*)0;
+        buffer->entries_capacity = (buffer->backing && (buffer->blob || !_blob_supported)) ? needed : 0;
+    }
 
-bool virtio_gpu_flush_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h)
-{
-    if (!_framebuffer.buffer || w == 0 || h == 0) 
+    if (needed > buffer->chunks_capacity)
     {
-        return false;
+        uint8_t** chunks = (uint8_t**)kmalloc_aligned(sizeof(uint8_t*) * needed, 4);
+        if (chunks && buffer->chunks)
+        {
+            memcpy(chunks, buffer->chunks, sizeof(uint8_t*) * buffer->chunk_count);
+        }
+
+        buffer->chunks = chunks;
+        buffer->chunks_capacity = chunks ? needed : 0;
     }
 
-    if (x >= _framebuffer.width || y >= _framebuffer.height) 
+    if (!buffer->rows || !buffer->backing || !buffer->chunks || buffer->entries_capacity < needed)
     {
         return false;
     }
 
-    if (x + w > _framebuffer.width) 
+    while (buffer->chunk_count < needed)
     {
-        w = _framebuffer.width - x;
+        uint8_t* memory = (uint8_t*)kmalloc_aligned(GPU_BACKING_CHUNK_BYTES, 4096);
+        if (!memory)
+        {
+            return false;
+        }
+
+        buffer->chunks[buffer->chunk_count++] = memory;
     }
 
-    if (y + h > _framebuffer.height)
+    VgMemoryEntry* entries = (VgMemoryEntry*)(buffer->backing + 1);
+
+    for (uint32_t chunk = 0; chunk < needed; chunk++)
     {
-        h = _framebuffer.height - y;
-    }
+        const uint32_t first_row = chunk * rows_per_chunk;
+        const uint32_t row_count = (height - first_row < rows_per_chunk) ? (height - first_row) : rows_per_chunk;
+        const uint32_t bytes = row_count * stride;
 
-    VgTransferToHost transfer;
-    VgResourceFlush flush;
-    VgResponseHeaderOnly response;
+        uint8_t* memory = buffer->chunks[chunk];
+        zero_bytes(memory, bytes);
 
-    gpu_hdr_init(&transfer.header, VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D);
-    transfer.rect.x = x;
-    transfer.rect.y = y;
-    transfer.rect.width = w;
-    transfer.rect.height = h;
-    transfer.offset = (uint64_t)y * (uint64_t)_framebuffer.stride_bytes + (uint64_t)x * 4ull;
-    transfer.resource_id = _resource_id;
-    transfer.padding = 0;
+        // the host concatenates the entries, so the backing still reads as
+        // one linear image with the usual stride
+        entries[chunk].address = (uint64_t)(uintptr_t)memory;
+        entries[chunk].length = bytes;
+        entries[chunk].padding = 0;
 
-    zero_bytes(&response, sizeof(response));
-    if (!gpu_send_cmd(&transfer, sizeof(transfer), &response, sizeof(response)))
-    {
-        return false;
+        for (uint32_t row = 0; row < row_count; row++)
+        {
+            buffer->rows[first_row + row] = (uint32_t*)(memory + row * stride);
+        }
     }
-    if (response.header.type != VIRTIO_GPU_RESP_OK_NODATA) 
+
+    if (buffer->blob)
     {
-        return false;
+        memcpy(buffer->blob + 1, entries, sizeof(VgMemoryEntry) * needed);
     }
 
-    gpu_hdr_init(&flush.header, VIRTIO_GPU_CMD_RESOURCE_FLUSH);
-    flush.rect.x = x;
-    flush.rect.y = y;
-    flush.rect.width = w;
-    flush.rect.height = h;
-    flush.resource_id = _resource_id;
-    flush.padding = 0;
+    buffer->entry_count = needed;
+    return true;
+}
+
+static bool gpu_create_blob(const GpuScanoutBuffer* buffer, uint64_t size)
+{
+    VgCreateBlob* message = buffer->blob;
+    VgResponseHeaderOnly response;
+
+    gpu_hdr_init(&message->header, VIRTIO_GPU_CMD_RESOURCE_CREATE_BLOB);
+    message->resource_id = buffer->resource_id;
+    message->blob_mem = VIRTIO_GPU_BLOB_MEM_GUEST;
+    message->blob_flags = 0;
+    message->nr_entries = buffer->entry_count;
+    message->blob_id = 0;
+    message->size = size;
+
+    const uint32_t length = (uint32_t)(sizeof(VgCreateBlob) + sizeof(VgMemoryEntry) * buffer->entry_count);
 
     zero_bytes(&response, sizeof(response));
-    if (!gpu_send_cmd(&flush, sizeof(flush), &response, sizeof(response)))
+
+    if (!gpu_send_cmd(message, length, &response, sizeof(response)))
     {
         return false;
     }
@@ -358,102 +754,980 @@ bool virtio_gpu_flush_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h)
     return response.header.type == VIRTIO_GPU_RESP_OK_NODATA;
 }
 
-bool virtio_gpu_init(FramebufferInfo* out_fb)
+static void gpu_fill_scanout_blob(VgScanoutBlob* scanout, uint32_t scanout_id, uint32_t resource_id, const FramebufferInfo* framebuffer)
 {
-    printf("virtio-gpu: init...\n");
-    if (!virtio_mmio_find_device(16, &_device))
+    gpu_hdr_init(&scanout->header, VIRTIO_GPU_CMD_SET_SCANOUT_BLOB);
+    scanout->rect.x = 0;
+    scanout->rect.y = 0;
+    scanout->rect.width = framebuffer->width;
+    scanout->rect.height = framebuffer->height;
+    scanout->scanout_id = scanout_id;
+    scanout->resource_id = resource_id;
+    scanout->width = framebuffer->width;
+    scanout->height = framebuffer->height;
+    scanout->format = VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM;
+    scanout->padding = 0;
+
+    for (uint32_t i = 0; i < 4; i++)
     {
-        printf("virtio-gpu: not found\n");
-        return false;
+        scanout->strides[i] = (i == 0) ? framebuffer->stride_bytes : 0;
+        scanout->offsets[i] = 0;
     }
+}
 
-    printf("virtio-gpu: found @0x%x v%u\n", (unsigned)_device.base, (unsigned)_device.version);
+static bool gpu_resource_command(uint32_t type, uint32_t resource_id)
+{
+    VgResourceReference request;
+    VgResponseHeaderOnly response;
 
-    if (!virtio_mmio_init(&_device))
+    gpu_hdr_init(&request.header, type);
+    request.resource_id = resource_id;
+    request.padding = 0;
+
+    if (!gpu_send_cmd(&request, sizeof(request), &response, sizeof(response)))
     {
-        printf("virtio-gpu: init failed\n");
         return false;
     }
 
-    printf("virtio-gpu: mmio init ok\n");
+    return response.header.type == VIRTIO_GPU_RESP_OK_NODATA;
+}
 
-    uint64_t accepted;
-    (void)accepted;
+static bool gpu_set_scanout(uint32_t scanout_id, uint32_t resource_id, uint32_t width, uint32_t height)
+{
+    VgScanoutInfo request;
+    VgResponseHeaderOnly response;
+
+    gpu_hdr_init(&request.header, VIRTIO_GPU_CMD_SET_SCANOUT);
+    request.rect.x = 0;
+    request.rect.y = 0;
+    request.rect.width = width;
+    request.rect.height = height;
+    request.scanout_id = scanout_id;
+    request.resource_id = resource_id;
 
-    if (!virtio_mmio_negotiate(&_device, (1ull << 32), &accepted))
+    zero_bytes(&response, sizeof(response));
+
+    if (!gpu_send_cmd(&request, sizeof(request), &response, sizeof(response)))
     {
-        printf("virtio-gpu: feature negotiation failed\n");
         return false;
     }
 
-    printf("virtio-gpu: features ok (accepted hi=0x%x)\n", (unsigned)(accepted >> 32));
-
-    if (!virtq_init(&_device, 0, 16, &_control_queue))
+    if (response.header.type != VIRTIO_GPU_RESP_OK_NODATA)
     {
-        printf("virtio-gpu: ctrlq init failed (need virtio-mmio v2)\n");
+        printf("virtio-gpu: set_scanout response=0x%x\n", (unsigned)response.header.type);
         return false;
     }
 
-    printf("virtio-gpu: ctrlq ready\n");
+    return true;
+}
 
-    uint32_t status = mmio_read32(_device.base, VIRTIO_MMIO_STATUS);
-    // driver status OK
-    mmio_write32(_device.base, VIRTIO_MMIO_STATUS, status | 4u);
-    fence_iorw();
-    printf("virtio-gpu: driver_ok\n");
+static bool gpu_set_scanout_blob(uint32_t scanout_id, uint32_t resource_id, const FramebufferInfo* framebuffer)
+{
+    VgScanoutBlob request;
+    VgResponseHeaderOnly response;
+
+    gpu_fill_scanout_blob(&request, scanout_id, resource_id, framebuffer);
+    zero_bytes(&response, sizeof(response));
 
-    uint32_t w = 0, h = 0;
-    if (!gpu_get_display(&w, &h))
+    if (!gpu_send_cmd(&request, sizeof(request), &response, sizeof(response)))
+    {
+        return false;
+    }
+
+    if (response.header.type != VIRTIO_GPU_RESP_OK_NODATA)
+    {
+        printf("virtio-gpu: set_scanout_blob response=0x%x\n", (unsigned)response.header.type);
+        return false;
+    }
+
+    return true;
+}
+
+static bool gpu_clip_rect(const FramebufferInfo* framebuffer, const FramebufferRect* rect, VgRect* out_rect)
+{
+    uint32_t x = rect->x;
+    uint32_t y = rect->y;
+    uint32_t w = rect->width;
+    uint32_t h = rect->height;
+
+    if (w == 0 || h == 0 || x >= framebuffer->width || y >= framebuffer->height)
     {
-        printf("virtio-gpu: GET_DISPLAY_INFO failed\n");
         return false;
     }
 
-    printf("virtio-gpu: display %dx%d\n", (int)w, (int)h);
+    if (x + w > framebuffer->width) 
+    {
+        w = framebuffer->width - x;
+    }
+
+    if (y + h > framebuffer->height)
+    {
+        h = framebuffer->height - y;
+    }
+
+    out_rect->x = x;
+    out_rect->y = y;
+    out_rect->width = w;
+    out_rect->height = h;
+    return true;
+}
+
+static uint32_t gpu_queue_transfer(uint32_t resource_id, uint32_t stride_bytes, const VgRect* rect, uint64_t* out_fence)
+{
+    GpuCommandSlot* slot = gpu_slot_reserve();
+    if (!slot)
+    {
+        return 0;
+    }
+
+    VgTransferToHost* transfer = &slot->request.transfer;
+    gpu_hdr_init(&transfer->header, VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D);
+    transfer->rect = *rect;
+    transfer->offset = (uint64_t)rect->y * (uint64_t)stride_bytes + (uint64_t)rect->x * 4ull;
+    transfer->resource_id = resource_id;
+    transfer->padding = 0;
+
+    if (out_fence)
+    {
+        *out_fence = gpu_hdr_fence(&transfer->header);
+    }
+
+    return gpu_slot_submit(slot, transfer, sizeof(*transfer), &slot->response_storage, sizeof(slot->response_storage));
+}
+
+static uint32_t gpu_queue_scanout(uint32_t scanout_id, const GpuScanout* head, const GpuScanoutBuffer* buffer)
+{
+    GpuCommandSlot* slot = gpu_slot_reserve();
+    if (!slot)
+    {
+        return 0;
+    }
+
+    if (head->blob)
+    {
+        VgScanoutBlob* scanout = &slot->request.scanout_blob;
+        gpu_fill_scanout_blob(scanout, scanout_id, buffer->resource_id, &head->framebuffer);
+        return gpu_slot_submit(slot, scanout, sizeof(*scanout), &slot->response_storage, sizeof(slot->response_storage));
+    }
+
+    VgScanoutInfo* scanout = &slot->request.scanout;
+    gpu_hdr_init(&scanout->header, VIRTIO_GPU_CMD_SET_SCANOUT);
+    scanout->rect.x = 0;
+    scanout->rect.y = 0;
+    scanout->rect.width = head->framebuffer.width;
+    scanout->rect.height = head->framebuffer.height;
+    scanout->scanout_id = scanout_id;
+    scanout->resource_id = buffer->resource_id;
+
+    return gpu_slot_submit(slot, scanout, sizeof(*scanout), &slot->response_storage, sizeof(slot->response_storage));
+}
+
+static uint32_t gpu_queue_flush(const GpuScanoutBuffer* buffer, const VgRect* rect, uint64_t* out_fence)
+{
+    GpuCommandSlot* slot = gpu_slot_reserve();
+    if (!slot)
+    {
+        return 0;
+    }
+
+    VgResourceFlush* flush = &slot->request.flush;
+    gpu_hdr_init(&flush->header, VIRTIO_GPU_CMD_RESOURCE_FLUSH);
+    flush->rect = *rect;
+    flush->resource_id = buffer->resource_id;
+    flush->padding = 0;
+
+    if (out_fence)
+    {
+        *out_fence = gpu_hdr_fence(&flush->header);
+    }
+
+    return gpu_slot_submit(slot, flush, sizeof(*flush), &slot->response_storage, sizeof(slot->response_storage));
+}
+
+static VgRect gpu_union_rect(const VgRect* a, const VgRect* b)
+{
+    const uint32_t left = min(a->x, b->x);
+    const uint32_t top = min(a->y, b->y);
+    const uint32_t right = max(a->x + a->width, b->x + b->width);
+    const uint32_t bottom = max(a->y + a->height, b->y + b->height);
+
+    return (VgRect){ left, top, right - left, bottom - top };
+}
+
+static uint64_t gpu_rect_area(const VgRect* rect)
+{
+    return (uint64_t)rect->width * rect->height;
+}
+
+// merges the pair whose union adds the least area until at most limit rects
+// are left; transferring a little extra is cheaper than a split batch
+static size_t gpu_merge_rects(VgRect* rects, size_t count, size_t limit)
+{
+    while (count > limit && count > 1)
+    {
+        size_t best_a = 0;
+        size_t best_b = 1;
+        int64_t best_cost = INT64_MAX;
+
+        for (size_t a = 0; a < count; a++)
+        {
+            for (size_t b = a + 1; b < count; b++)
+            {
+                const VgRect merged = gpu_union_rect(&rects[a], &rects[b]);
+                // overlapping rects come out negative and merge first
+                const int64_t cost = (int64_t)gpu_rect_area(&merged) - (int64_t)gpu_rect_area(&rects[a]) -
+                                     (int64_t)gpu_rect_area(&rects[b]);
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_a = a;
+                    best_b = b;
+                }
+            }
+        }
+
+        rects[best_a] = gpu_union_rect(&rects[best_a], &rects[best_b]);
+        rects[best_b] = rects[--count];
+    }
+
+    return count;
+}
+
+static void gpu_add_unsent(GpuScanoutBuffer* buffer, const VgRect* rect)
+{
+    if (buffer->unsent_count == VIRTIO_GPU_MAX_PRESENT_RECTS)
+    {
+        buffer->unsent_count = (uint32_t)gpu_merge_rects(buffer->unsent, buffer->unsent_count, VIRTIO_GPU_MAX_PRESENT_RECTS - 1u);
+    }
+
+    buffer->unsent[buffer->unsent_count++] = *rect;
+}
+
+static void gpu_copy_rect(uint32_t** destination, uint32_t* const* source, const VgRect* rect)
+{
+    for (uint32_t y = rect->y; y < rect->y + rect->height; y++)
+    {
+        memcpy(&destination[y][rect->x], &source[y][rect->x], rect->width * 4u);
+    }
+}
+
+// Catches the back buffer up with the front one. Anything that reads or
+// writes the back buffer's pixels has to go through here first.
+static void gpu_prepare_back(GpuScanout* head)
+{
+    GpuScanoutBuffer* back = &head->buffers[head->back];
+    const GpuScanoutBuffer* front = &head->buffers[head->back ^ 1u];
+
+    // the new back buffer was last presented a frame ago; its transfer has
+    // almost always completed, but it must not be overwritten until it has
+    if (back->last_read != 0)
+    {
+        gpu_fence_wait(back->last_read);
+        back->last_read = 0;
+    }
+
+    // the copy only reaches guest memory; a 2D resource picks it up with
+    // this buffer's next present
+    for (uint32_t i = 0; i < head->carry_count; i++)
+    {
+        gpu_copy_rect(back->rows, front->rows, &head->carry[i]);
+        if (!head->blob)
+        {
+            gpu_add_unsent(back, &head->carry[i]);
+        }
+    }
+    head->carry_count = 0;
+}
+
+void virtio_gpu_prepare_back(uint32_t scanout)
+{
+    if (scanout < VIRTIO_GPU_MAX_SCANOUTS && _scanouts[scanout].active)
+    {
+        gpu_prepare_back(&_scanouts[scanout]);
+    }
+}
+
+bool virtio_gpu_present(const FramebufferPresent* presents, size_t count)
+{
+    // clipped damage per request; kept static so a full batch of heads does
+    // not land on the stack
+    static VgRect rects[VIRTIO_GPU_MAX_SCANOUTS][VIRTIO_GPU_MAX_PRESENT_RECTS];
+    size_t valid[VIRTIO_GPU_MAX_SCANOUTS];
+
+    // one head's transfers: its damage plus whatever the back buffer's host
+    // resource still lacks from earlier frames
+    static VgRect transfers[VIRTIO_GPU_MAX_PRESENT_RECTS * 2u];
 
+    if (count > VIRTIO_GPU_MAX_SCANOUTS)
+    {
+        count = VIRTIO_GPU_MAX_SCANOUTS;
+    }
+
+    bool ok = true;
+    bool queued = false;
+    size_t damaged = 0;
+
+    for (size_t p = 0; p < count; p++)
+    {
+        const FramebufferPresent* present = &presents[p];
+        valid[p] = 0;
+
+        if (present->scanout >= VIRTIO_GPU_MAX_SCANOUTS || !_scanouts[present->scanout].active)
+        {
+            ok = false;
+            continue;
+        }
+
+        const GpuScanout* head = &_scanouts[present->scanout];
+
+        for (size_t i = 0; i < present->count && valid[p] < VIRTIO_GPU_MAX_PRESENT_RECTS; i++)
+        {
+            if (gpu_clip_rect(&head->framebuffer, &present->damage[i], &rects[p][valid[p]]))
+            {
+                valid[p]++;
+            }
+        }
+
+        if (valid[p] != 0)
+        {
+            damaged++;
+        }
+    }
+
+    // A head costs its transfers plus a flip and one flush, two descriptors
+    // each. Every head's damage is merged down to its share of the control
+    // queue so the whole frame goes out under one notify. Past about ten
+    // heads not even one transfer each fits; the batch is then kicked in
+    // pieces as gpu_slot_reserve waits for room.
+    const size_t ring_commands = _control_queue.queue_size / 2u;
+    const size_t head_commands = damaged ? ring_commands / damaged : ring_commands;
+    const size_t transfer_limit = (head_commands > 3u) ? head_commands - 2u : 1u;
+
+    // the device handles the control queue in order, so only the last
+    // transfer and the flush of each head need fences, and the final head's
+    // flush fence covers the whole batch
+    for (size_t p = 0; p < count; p++)
+    {
+        const FramebufferPresent* present = &presents[p];
+        if (valid[p] == 0)
+        {
+            continue;
+        }
+
+        GpuScanout* head = &_scanouts[present->scanout];
+        GpuScanoutBuffer* back = &head->buffers[head->back];
+
+        // a back buffer that was never drawn into still has last frame's
+        // damage to pick up before it goes out
+        gpu_prepare_back(head);
+
+        // a blob is read straight out of the backing, so there is nothing
+        // to copy to the host first
+        size_t transfer_count = 0;
+        if (!head->blob)
+        {
+            for (size_t i = 0; i < valid[p]; i++)
+            {
+                transfers[transfer_count++] = rects[p][i];
+            }
+            for (uint32_t i = 0; i < back->unsent_count; i++)
+            {
+                transfers[transfer_count++] = back->unsent[i];
+            }
+            back->unsent_count = 0;
+
+            transfer_count = gpu_merge_rects(transfers, transfer_count, transfer_limit);
+        }
+
+        for (size_t i = 0; i < transfer_count; i++)
+        {
+            uint64_t* fence = (i == transfer_count - 1) ? &back->last_read : (uint64_t*)0;
+            if (gpu_queue_transfer(back->resource_id, head->framebuffer.stride_bytes, &transfers[i], fence) == 0)
+            {
+                ok = false;
+            }
+        }
+
+        if (gpu_queue_scanout(present->scanout, head, back) == 0)
+        {
+            ok = false;
+        }
+
+        // the host only needs to know which part of the scanout to refresh,
+        // so one flush over all of the damage does
+        VgRect bounds = rects[p][0];
+        for (size_t i = 1; i < valid[p]; i++)
+        {
+            bounds = gpu_union_rect(&bounds, &rects[p][i]);
+        }
+        for (size_t i = 0; i < transfer_count; i++)
+        {
+            bounds = gpu_union_rect(&bounds, &transfers[i]);
+        }
+
+        if (gpu_queue_flush(back, &bounds, &_present_fence) == 0)
+        {
+            ok = false;
+        }
+
+        // the host keeps reading a blob for as long as it is scanned out, so
+        // the outgoing front buffer is only free once this flip has landed
+        if (head->blob)
+        {
+            head->buffers[head->back ^ 1u].last_read = _present_fence;
+        }
+
+        queued = true;
+    }
+
+    if (queued)
+    {
+        gpu_kick();
+    }
+
+    for (size_t p = 0; p < count; p++)
+    {
+        const FramebufferPresent* present = &presents[p];
+        if (valid[p] == 0)
+        {
+            if (present->out_back && present->scanout < VIRTIO_GPU_MAX_SCANOUTS)
+            {
+                *present->out_back = _scanouts[present->scanout].framebuffer;
+            }
+            continue;
+        }
+
+        GpuScanout* head = &_scanouts[present->scanout];
+
+        head->back ^= 1u;
+        const GpuScanoutBuffer* back = &head->buffers[head->back];
+
+        // no waiting here: the new back buffer is only caught up once the
+        // caller is about to touch it
+        for (size_t i = 0; i < valid[p]; i++)
+        {
+            head->carry[i] = rects[p][i];
+        }
+        head->carry_count = (uint32_t)valid[p];
+
+        head->framebuffer.rows = back->rows;
+        if (present->out_back)
+        {
+            *present->out_back = head->framebuffer;
+        }
+    }
+
+    return ok;
+}
+
+void virtio_gpu_submit(void)
+{
+    gpu_kick();
+    gpu_reap();
+}
+
+bool virtio_gpu_wait(uint32_t sequence)
+{
+    return gpu_wait(sequence);
+}
+
+VirtioGpuResult virtio_gpu_result(uint32_t sequence)
+{
+    gpu_reap();
+    return gpu_result(sequence);
+}
+
+uint64_t virtio_gpu_present_fence(void)
+{
+    return _present_fence;
+}
+
+uint64_t virtio_gpu_fence_completed(void)
+{
+    gpu_reap();
+    return _fence_completed;
+}
+
+bool virtio_gpu_fence_wait(uint64_t fence_id)
+{
+    return gpu_fence_wait(fence_id);
+}
+
+uint32_t virtio_gpu_error_count(void)
+{
+    return _command_errors;
+}
+
+static bool gpu_cursor_send(uint32_t type, uint32_t scanout_id, uint32_t resource_id)
+{
+    uint16_t used;
+    while (virtq_poll_used(&_cursor_queue, &used))
+    {
+        virtq_free_chain(&_cursor_queue, used);
+    }
+
+    int head = virtq_alloc_chain(&_cursor_queue, 1);
+    if (head < 0)
+    {
+        return false;
+    }
+
+    VgUpdateCursor* command = &_cursor_commands[head];
+    gpu_hdr_init(&command->header, type);
+    command->position.scanout_id = scanout_id;
+    command->position.x = _cursor_x;
+    command->position.y = _cursor_y;
+    command->position.padding = 0;
+    command->resource_id = resource_id;
+    command->hot_x = _cursor_hot_x;
+    command->hot_y = _cursor_hot_y;
+    command->padding = 0;
+
+    _cursor_queue.descriptor[head].address = (uint64_t)(uintptr_t)command;
+    _cursor_queue.descriptor[head].length = sizeof(*command);
+
+    virtq_submit(&_cursor_queue, (uint16_t)head);
+    virtq_notify(&_cursor_queue);
+    return true;
+}
+
+static bool gpu_cursor_init(void)
+{
+    const uint32_t cursor_bytes = GPU_CURSOR_SIZE * GPU_CURSOR_SIZE * 4u;
+
+    _cursor_pixels = (uint32_t*)kmalloc_aligned(cursor_bytes, 4096);
+    if (!_cursor_pixels)
+    {
+        return false;
+    }
+
+    zero_bytes(_cursor_pixels, cursor_bytes);
+
+    if (!gpu_create_resource(GPU_CURSOR_RESOURCE_ID, VIRTIO_GPU_FORMAT_B8G8R8A8_UNORM, GPU_CURSOR_SIZE, GPU_CURSOR_SIZE))
+    {
+        return false;
+    }
+
+    static struct PACKED
+    {
+        VgAttachBacking request;
+        VgMemoryEntry entry;
+    } message;
+
+    message.entry.address = (uint64_t)(uintptr_t)_cursor_pixels;
+    message.entry.length = cursor_bytes;
+    message.entry.padding = 0;
+
+    return gpu_attach_backing(GPU_CURSOR_RESOURCE_ID, &message.request, 1);
+}
+
+bool virtio_gpu_cursor_available(void)
+{
+    return _cursor_ok;
+}
+
+bool virtio_gpu_cursor_define(const uint32_t* argb, uint32_t width, uint32_t height, uint32_t hot_x, uint32_t hot_y)
+{
+    if (!_cursor_ok || !argb || width > GPU_CURSOR_SIZE || height > GPU_CURSOR_SIZE)
+    {
+        return false;
+    }
+
+    zero_bytes(_cursor_pixels, GPU_CURSOR_SIZE * GPU_CURSOR_SIZE * 4u);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        memcpy(&_cursor_pixels[y * GPU_CURSOR_SIZE], &argb[y * width], width * 4u);
+    }
+
+    const VgRect rect = { 0, 0, GPU_CURSOR_SIZE, GPU_CURSOR_SIZE };
+    uint64_t fence = 0;
+
+    // the two queues are not ordered against each other, so the image has to
+    // land before the cursor queue is told to use it
+    if (gpu_queue_transfer(GPU_CURSOR_RESOURCE_ID, GPU_CURSOR_SIZE * 4u, &rect, &fence) == 0 || !gpu_fence_wait(fence))
+    {
+        return false;
+    }
+
+    _cursor_hot_x = hot_x;
+    _cursor_hot_y = hot_y;
+
+    return _cursor_visible ? gpu_cursor_send(VIRTIO_GPU_CMD_UPDATE_CURSOR, _cursor_scanout, GPU_CURSOR_RESOURCE_ID) : true;
+}
+
+bool virtio_gpu_cursor_move(uint32_t scanout, uint32_t x, uint32_t y)
+{
+    if (!_cursor_ok || scanout >= VIRTIO_GPU_MAX_SCANOUTS)
+    {
+        return false;
+    }
+
+    if (scanout == _cursor_scanout && x == _cursor_x && y == _cursor_y)
+    {
+        return true;
+    }
+
+    const uint32_t previous = _cursor_scanout;
+
+    _cursor_scanout = scanout;
+    _cursor_x = x;
+    _cursor_y = y;
+
+    if (!_cursor_visible)
+    {
+        return true;
+    }
+
+    if (scanout == previous)
+    {
+        return gpu_cursor_send(VIRTIO_GPU_CMD_MOVE_CURSOR, scanout, GPU_CURSOR_RESOURCE_ID);
+    }
+
+    // the image is attached per head: hide it on the old one and set it up
+    // again on the new one
+    gpu_cursor_send(VIRTIO_GPU_CMD_UPDATE_CURSOR, previous, 0);
+    return gpu_cursor_send(VIRTIO_GPU_CMD_UPDATE_CURSOR, scanout, GPU_CURSOR_RESOURCE_ID);
+}
+
+bool virtio_gpu_cursor_show(bool visible)
+{
+    if (!_cursor_ok)
+    {
+        return false;
+    }
+
+    if (visible == _cursor_visible)
+    {
+        return true;
+    }
+
+    _cursor_visible = visible;
+
+    // resource 0 hides the cursor
+    return gpu_cursor_send(VIRTIO_GPU_CMD_UPDATE_CURSOR, _cursor_scanout, visible ? GPU_CURSOR_RESOURCE_ID : 0);
+}
+
+static bool gpu_create_scanout_resources(GpuScanout* head, uint32_t w, uint32_t h)
+{
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        GpuScanoutBuffer* buffer = &head->buffers[i];
+
+        if (head->blob)
+        {
+            if (!gpu_create_blob(buffer, (uint64_t)head->framebuffer.stride_bytes * h))
+            {
+                printf("virtio-gpu: create blob failed\n");
+                return false;
+            }
+            continue;
+        }
+
+        if (!gpu_create_resource(buffer->resource_id, VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM, w, h))
+        {
+            printf("virtio-gpu: create resource failed\n");
+            return false;
+        }
+
+        if (!gpu_attach_backing(buffer->resource_id, buffer->backing, buffer->entry_count))
+        {
+            printf("virtio-gpu: attach backing failed\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool gpu_setup_scanout(uint32_t scanout, uint32_t w, uint32_t h)
+{
     const uint32_t bits_per_pixel = 4;
     const uint32_t stride = w * bits_per_pixel;
-    const uint32_t framebuffer_bytes = stride * h;
 
-    uint32_t* buffer = (uint32_t*)kmalloc_aligned(framebuffer_bytes, 4096);
-    if (!buffer)
+    GpuScanout* head = &_scanouts[scanout];
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        GpuScanoutBuffer* buffer = &head->buffers[i];
+        buffer->resource_id = GPU_SCANOUT_RESOURCE_ID(scanout, i);
+        buffer->last_read = 0;
+        buffer->unsent_count = 0;
+
+        if (!gpu_alloc_backing(buffer, stride, h))
+        {
+            printf("virtio-gpu: framebuffer alloc failed\n");
+            return false;
+        }
+    }
+
+    printf("virtio-gpu: scanout %u backing uses %u chunks per buffer\n", (unsigned)scanout, (unsigned)head->buffers[0].entry_count);
+
+    head->framebuffer.width = w;
+    head->framebuffer.height = h;
+    head->framebuffer.stride_bytes = stride;
+
+    // scan out buffer 0 first and hand buffer 1 to the renderer
+    head->back = 1;
+    head->carry_count = 0;
+
+    // prefer blobs; if the host turns them down, drop back to 2D resources
+    // for this and every later head
+    head->blob = _blob_supported;
+    if (head->blob)
+    {
+        if (gpu_create_scanout_resources(head, w, h) &&
+            gpu_set_scanout_blob(scanout, head->buffers[0].resource_id, &head->framebuffer))
+        {
+            printf("virtio-gpu: scanout %u uses blob resources\n", (unsigned)scanout);
+        }
+        else
+        {
+            for (uint32_t i = 0; i < 2; i++)
+            {
+                gpu_resource_command(VIRTIO_GPU_CMD_RESOURCE_UNREF, head->buffers[i].resource_id);
+            }
+
+            printf("virtio-gpu: blob scanout failed, falling back to 2D\n");
+            _blob_supported = false;
+            head->blob = false;
+        }
+    }
+
+    if (!head->blob)
+    {
+        if (!gpu_create_scanout_resources(head, w, h))
+        {
+            return false;
+        }
+
+        if (!gpu_set_scanout(scanout, head->buffers[0].resource_id, w, h))
+        {
+            printf("virtio-gpu: set scanout failed\n");
+            return false;
+        }
+    }
+
+    head->framebuffer.rows = head->buffers[head->back].rows;
+    head->active = true;
+    return true;
+}
+
+static void gpu_release_scanout(uint32_t scanout)
+{
+    GpuScanout* head = &_scanouts[scanout];
+
+    // resource 0 disables the scanout
+    gpu_set_scanout(scanout, 0, 0, 0);
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        // a blob's memory is bound for its whole lifetime and goes with it
+        if (!head->blob)
+        {
+            gpu_resource_command(VIRTIO_GPU_CMD_RESOURCE_DETACH_BACKING, head->buffers[i].resource_id);
+        }
+        gpu_resource_command(VIRTIO_GPU_CMD_RESOURCE_UNREF, head->buffers[i].resource_id);
+    }
+
+    head->active = false;
+    head->framebuffer.rows = (uint32_t**)0;
+    head->framebuffer.width = 0;
+    head->framebuffer.height = 0;
+}
+
+uint32_t virtio_gpu_poll_resize(void)
+{
+    if (!_ready)
+    {
+        return 0;
+    }
+
+    const uint32_t events = mmio_read32(_device.base, VIRTIO_GPU_CONFIG_EVENTS_READ);
+    if ((events & VIRTIO_GPU_EVENT_DISPLAY) == 0)
+    {
+        return 0;
+    }
+
+    mmio_write32(_device.base, VIRTIO_GPU_CONFIG_EVENTS_CLEAR, VIRTIO_GPU_EVENT_DISPLAY);
+    fence_iorw();
+
+    VgRect modes[VIRTIO_GPU_MAX_SCANOUTS];
+    if (!gpu_get_display(modes))
+    {
+        return 0;
+    }
+
+    uint32_t changed = 0;
+
+    for (uint32_t i = 0; i < _scanout_count; i++)
+    {
+        const GpuScanout* head = &_scanouts[i];
+        if (modes[i].width == head->framebuffer.width && modes[i].height == head->framebuffer.height)
+        {
+            continue;
+        }
+
+        // nothing may still be reading the backings that are about to be reused
+        if (changed == 0)
+        {
+            gpu_wait(0);
+        }
+
+        changed |= 1u << i;
+
+        if (head->active)
+        {
+            gpu_release_scanout(i);
+        }
+
+        if (modes[i].width == 0 || modes[i].height == 0)
+        {
+            printf("virtio-gpu: scanout %u disabled\n", (unsigned)i);
+            continue;
+        }
+
+        printf("virtio-gpu: scanout %u resized to %dx%d\n", (unsigned)i, (int)modes[i].width, (int)modes[i].height);
+
+        if (!gpu_setup_scanout(i, modes[i].width, modes[i].height))
+        {
+            printf("virtio-gpu: scanout %u resize failed\n", (unsigned)i);
+            _scanouts[i].active = false;
+            _scanouts[i].framebuffer.rows = (uint32_t**)0;
+        }
+    }
+
+    return changed;
+}
+
+uint32_t virtio_gpu_scanout_count(void)
+{
+    return _scanout_count;
+}
+
+bool virtio_gpu_get_scanout(uint32_t scanout, FramebufferInfo* out_fb)
+{
+    if (scanout >= VIRTIO_GPU_MAX_SCANOUTS || !_scanouts[scanout].active)
+    {
+        return false;
+    }
+
+    if (out_fb)
+    {
+        *out_fb = _scanouts[scanout].framebuffer;
+    }
+
+    return true;
+}
+
+const ViQueue* virtio_gpu_control_queue(void)
+{
+    return &_control_queue;
+}
+
+bool virtio_gpu_init(void)
+{
+    printf("virtio-gpu: init...\n");
+    if (!virtio_mmio_find_device(16, &_device))
     {
-        printf("virtio-gpu: framebuffer alloc failed\n");
+        printf("virtio-gpu: not found\n");
         return false;
     }
 
-    zero_bytes(buffer, framebuffer_bytes);
+    printf("virtio-gpu: found @0x%x v%u\n", (unsigned)_device.base, (unsigned)_device.version);
 
-    if (!gpu_create_resource(w, h))
+    if (!virtio_mmio_init(&_device))
     {
-        printf("virtio-gpu: create resource failed\n");
+        printf("virtio-gpu: init failed\n");
         return false;
     }
 
-    if (!gpu_attach_backing(buffer, framebuffer_bytes))
+    printf("virtio-gpu: mmio init ok\n");
+
+    uint64_t accepted;
+    (void)accepted;
+
+    if (!virtio_mmio_negotiate(&_device, (1ull << 32) | (1ull << VIRTIO_GPU_F_RESOURCE_BLOB), &accepted))
     {
-        printf("virtio-gpu: attach backing failed\n");
+        printf("virtio-gpu: feature negotiation failed\n");
         return false;
     }
 
-    if (!gpu_set_scanout(w, h))
+    printf("virtio-gpu: features ok (accepted hi=0x%x lo=0x%x)\n", (unsigned)(accepted >> 32), (unsigned)accepted);
+
+    _blob_supported = (accepted & (1ull << VIRTIO_GPU_F_RESOURCE_BLOB)) != 0;
+
+    if (!virtq_init(&_device, 0, GPU_CONTROL_QUEUE_SIZE, &_control_queue))
+    {
+        printf("virtio-gpu: ctrlq init failed (need virtio-mmio v2)\n");
+        return false;
+    }
+
+    // responses are only ever reaped synchronously, so the device never
+    // needs to interrupt us for this queue
+    virtq_set_mode(&_control_queue, VIRTQ_MODE_POLL);
+
+    printf("virtio-gpu: ctrlq ready\n");
+
+    // the cursor queue is optional; without it the console simply has no caret
+    _cursor_ok = virtq_init(&_device, 1, GPU_CURSOR_QUEUE_SIZE, &_cursor_queue);
+    if (_cursor_ok)
+    {
+        virtq_set_mode(&_cursor_queue, VIRTQ_MODE_POLL);
+    }
+
+    uint32_t status = mmio_read32(_device.base, VIRTIO_MMIO_STATUS);
+    // driver status OK
+    mmio_write32(_device.base, VIRTIO_MMIO_STATUS, status | 4u);
+    fence_iorw();
+    printf("virtio-gpu: driver_ok\n");
+
+    _scanout_count = mmio_read32(_device.base, VIRTIO_GPU_CONFIG_NUM_SCANOUTS);
+    if (_scanout_count == 0 || _scanout_count > VIRTIO_GPU_MAX_SCANOUTS)
+    {
+        _scanout_count = (_scanout_count == 0) ? 1 : VIRTIO_GPU_MAX_SCANOUTS;
+    }
+
+    VgRect modes[VIRTIO_GPU_MAX_SCANOUTS];
+    if (!gpu_get_display(modes))
     {
-        printf("virtio-gpu: set scanout failed\n");
+        printf("virtio-gpu: GET_DISPLAY_INFO failed\n");
         return false;
     }
 
-    _framebuffer.buffer = buffer;
-    _framebuffer.width = w;
-    _framebuffer.height = h;
-    _framebuffer.stride_bytes = stride;
+    printf("virtio-gpu: %u scanouts\n", (unsigned)_scanout_count);
 
-    if (out_fb) 
+    if (_cursor_ok && !gpu_cursor_init())
     {
-        *out_fb = _framebuffer;
+        printf("virtio-gpu: cursor setup failed\n");
+        _cursor_ok = false;
     }
 
-    virtio_gpu_flush_rect(0, 0, w, h);
+    uint32_t active = 0;
+
+    for (uint32_t i = 0; i < _scanout_count; i++)
+    {
+        if (modes[i].width == 0 || modes[i].height == 0)
+        {
+            continue;
+        }
+
+        if (!gpu_setup_scanout(i, modes[i].width, modes[i].height))
+        {
+            printf("virtio-gpu: scanout %u setup failed\n", (unsigned)i);
+            continue;
+        }
+
+        printf("virtio-gpu: scanout %u %dx%d framebuffer ready\n", (unsigned)i, (int)modes[i].width, (int)modes[i].height);
+        active++;
+    }
+
+    if (active == 0)
+    {
+        printf("virtio-gpu: no enabled displays\n");
+        return false;
+    }
 
-    printf("virtio-gpu: %dx%d framebuffer ready\n", (int)w, (int)h);
+    _ready = true;
     return true;
 }
@@ -5,15 +5,96 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+#include "virtio_mmio.h"
+
+// The framebuffer is not guaranteed to be contiguous; every row is reached
+// through its own pointer.
 typedef struct
 {
-    uint32_t* buffer;
+    uint32_t** rows;
     uint32_t width;
     uint32_t height;
     uint32_t stride_bytes;
 } FramebufferInfo;
 
-bool virtio_gpu_init(FramebufferInfo* out_fb);
-bool virtio_gpu_flush_rect(uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+typedef struct
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} FramebufferRect;
+
+// Damage for one display head; out_back receives that head's new back buffer.
+typedef struct
+{
+    uint32_t scanout;
+    const FramebufferRect* damage;
+    size_t count;
+    FramebufferInfo* out_back;
+} FramebufferPresent;
+
+#define VIRTIO_GPU_MAX_PRESENT_RECTS 16u
+#define VIRTIO_GPU_MAX_SCANOUTS 16u
+
+// Every enabled display head gets its own double-buffered framebuffer.
+// Scanout ids run up to virtio_gpu_scanout_count(); disabled ones are skipped.
+bool virtio_gpu_init(void);
+uint32_t virtio_gpu_scanout_count(void);
+bool virtio_gpu_get_scanout(uint32_t scanout, FramebufferInfo* out_fb);
+const ViQueue* virtio_gpu_control_queue(void);
+
+// Rendering always targets the back buffer. Presenting transfers the damaged
+// rects, flips the scanout to it and flushes, and returns without waiting on
+// the host. The damage is copied forward into the new back buffer, once the
+// host is done with it, by virtio_gpu_prepare_back; callers must make that
+// call before touching the back buffer's pixels after a present. On a 2D
+// resource the copy only reaches guest memory, so it is transferred along
+// with that buffer's next present.
+//
+// Damage may be merged into fewer, larger rects so that all heads in one call
+// fit the control queue and share a single notify; with more than about ten
+// heads the batch no longer fits and goes out in several kicks.
+bool virtio_gpu_present(const FramebufferPresent* presents, size_t count);
+void virtio_gpu_prepare_back(uint32_t scanout);
+
+// Checks the device config space for a display change event. Heads whose mode
+// changed are rebuilt at the new size (or torn down when disabled) and
+// returned as a bitmask of scanout ids.
+uint32_t virtio_gpu_poll_resize(void);
+
+// Hardware cursor on the cursor queue. The image is ARGB, at most 64x64, and
+// positions are in pixels of the given scanout; moving it costs one small
+// command.
+bool virtio_gpu_cursor_available(void);
+bool virtio_gpu_cursor_define(const uint32_t* argb, uint32_t width, uint32_t height, uint32_t hot_x, uint32_t hot_y);
+bool virtio_gpu_cursor_move(uint32_t scanout, uint32_t x, uint32_t y);
+bool virtio_gpu_cursor_show(bool visible);
+
+typedef enum
+{
+    VIRTIO_GPU_RESULT_PENDING,
+    VIRTIO_GPU_RESULT_OK,
+    VIRTIO_GPU_RESULT_FAILED,
+    // never issued, or too long ago to still be remembered
+    VIRTIO_GPU_RESULT_UNKNOWN,
+} VirtioGpuResult;
+
+// Pipelined command stream: commands are published with a single notify and
+// callers only block on an explicit wait. Sequence numbers are nonzero;
+// virtio_gpu_wait(0) waits for everything in flight. Waiting on a sequence
+// returns false if that command failed or the wait timed out; wait(0) only
+// reports a timeout. The outcome of the last 256 commands can be looked up
+// by sequence without waiting.
+void virtio_gpu_submit(void);
+bool virtio_gpu_wait(uint32_t sequence);
+VirtioGpuResult virtio_gpu_result(uint32_t sequence);
+uint32_t virtio_gpu_error_count(void);
+
+// Fences are handed out in increasing order and signal once the host has
+// finished the fenced command and everything queued before it.
+uint64_t virtio_gpu_present_fence(void);
+uint64_t virtio_gpu_fence_completed(void);
+bool virtio_gpu_fence_wait(uint64_t fence_id);
 
 #endif
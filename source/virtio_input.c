@@ -123,6 +123,11 @@ static VirtioInputEvent* _events;
 static VirtioInputEvent** _event_by_desc;
 static uint16_t _posted;
 
+// completions reaped by the last adaptive poll pass, handed out one at a time
+static uint16_t _reaped[VIRTQ_DEFAULT_POLL_BUDGET];
+static uint16_t _reaped_count;
+static uint16_t _reaped_next;
+
 static inline bool is_press_or_repeat(uint32_t value)
 {
     return value == 1u || value == 2u;
@@ -306,6 +311,9 @@ bool virtio_keyboard_init(void)
         return false;
     }
 
+    // buffers sit posted until a key is pressed
+    virtq_set_record_latency(&_eventq, false);
+
     // Allocate buffers and post them.
     const uint16_t qsz = _eventq.queue_size;
 
@@ -336,7 +344,7 @@ bool virtio_keyboard_init(void)
         }
     }
 
-    virtio_mmio_notify_queue(&_kbd_dev, 0);
+    virtq_notify(&_eventq);
 
     // DRIVER_OK
     uint32_t status = mmio_read32(_kbd_dev.base, VIRTIO_MMIO_STATUS);
@@ -345,8 +353,12 @@ bool virtio_keyboard_init(void)
 
     _modifiers = 0;
     _caps_lock = false;
+    _reaped_count = 0;
+    _reaped_next = 0;
     _keyboard_ok = true;
 
+    platform_enable_irq(_kbd_dev.irq);
+
     printf("virtio-kbd: ready (buffers=%u)\n", (unsigned)_posted);
     return true;
 }
@@ -360,17 +372,23 @@ bool virtio_keyboard_poll_event(KeyboardEvent* out_event)
 
     for (unsigned attempts = 0; attempts < 8; attempts++)
     {
-        uint16_t used_id;
-        if (!virtq_poll_used(&_eventq, &used_id))
+        if (_reaped_next == _reaped_count)
         {
-            return false;
+            _reaped_next = 0;
+            _reaped_count = virtq_adaptive_poll(&_eventq, _reaped, (uint16_t)(sizeof(_reaped) / sizeof(_reaped[0])));
+            if (_reaped_count == 0)
+            {
+                return false;
+            }
         }
 
+        const uint16_t used_id = _reaped[_reaped_next++];
+
         VirtioInputEvent* event = (used_id < _eventq.queue_size) ? _event_by_desc[used_id] : 0;
         if (!event)
         {
             virtq_submit(&_eventq, used_id);
-            virtio_mmio_notify_queue(&_kbd_dev, 0);
+            virtq_notify(&_eventq);
             continue;
         }
 
@@ -379,7 +397,7 @@ bool virtio_keyboard_poll_event(KeyboardEvent* out_event)
         const uint32_t value = event->value;
 
         virtq_submit(&_eventq, used_id);
-        virtio_mmio_notify_queue(&_kbd_dev, 0);
+        virtq_notify(&_eventq);
 
         if (type == EV_SYN)
         {
@@ -404,3 +422,18 @@ bool virtio_keyboard_poll_event(KeyboardEvent* out_event)
 
     return false;
 }
+
+const ViQueue* virtio_keyboard_event_queue(void)
+{
+    return _keyboard_ok ? &_eventq : (const ViQueue*)0;
+}
+
+bool virtio_keyboard_idle(void)
+{
+    if (!_keyboard_ok)
+    {
+        return true;
+    }
+
+    return _reaped_next == _reaped_count && _eventq.mode == VIRTQ_MODE_INTERRUPT;
+}
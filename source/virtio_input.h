@@ -7,8 +7,13 @@
 #include <stdbool.h>
 
 #include "platform.h"
+#include "virtio_mmio.h"
 
 bool virtio_keyboard_init(void);
 bool virtio_keyboard_poll_event(KeyboardEvent* out_event);
+const ViQueue* virtio_keyboard_event_queue(void);
+// True when nothing is buffered and the event queue waits on its interrupt,
+// so the hart may sleep until the next key.
+bool virtio_keyboard_idle(void);
 
 #endif
@@ -1,5 +1,6 @@
 #include "virtio_mmio.h"
 #include "memory.h"
+#include "platform.h"
 #include "utility.h"
 
 // virtIO-MMIO register offsets
@@ -109,6 +110,9 @@ bool virtio_mmio_find_device(uint32_t device_id, ViMMIODevice* output_device)
 
         output_device->base = base;
         output_device->version = mmio_read32(base, VIRTIO_MMIO_VERSION);
+        output_device->interrupt_count = 0;
+        // the virt machine wires transport i to PLIC source i + 1
+        output_device->irq = 1u + i;
         return true;
     }
 
@@ -187,6 +191,25 @@ bool virtio_mmio_negotiate(ViMMIODevice* device, uint64_t wanted_features, uint6
     return true;
 }
 
+uint32_t virtio_mmio_ack_interrupt(ViMMIODevice* device)
+{
+    const uint32_t status = mmio_read32(device->base, VIRTIO_MMIO_INTERRUPT_STATUS);
+    if (status == 0)
+    {
+        return 0;
+    }
+
+    mmio_write32(device->base, VIRTIO_MMIO_INTERRUPT_ACK, status);
+    fence_iorw();
+
+    if (status & VIRTIO_MMIO_INT_VRING)
+    {
+        device->interrupt_count++;
+    }
+
+    return status;
+}
+
 static void virtq_init_free_list(ViQueue* queue)
 {
     queue->free_head = 0;
@@ -244,7 +267,8 @@ bool virtq_init(ViMMIODevice* device, uint32_t queue_index, uint16_t queue_size,
     VqAvailable* available = (VqAvailable*)0;
     VqConsumed* used = (VqConsumed*)0;
     uint16_t* free_next = (uint16_t*)kmalloc_aligned(sizeof(uint16_t) * queue_size, 2);
-    if (!free_next)
+    uint32_t* submit_time = (uint32_t*)kmalloc_aligned(sizeof(uint32_t) * queue_size, 4);
+    if (!free_next || !submit_time)
     {
         printf("virtq_init: alloc failed free_next\n");
         return false;
@@ -293,8 +317,23 @@ bool virtq_init(ViMMIODevice* device, uint32_t queue_index, uint16_t queue_size,
     output_queue->free_next = free_next;
     output_queue->last_used_index = 0;
 
+    output_queue->queue_index = queue_index;
+    output_queue->mode = VIRTQ_MODE_INTERRUPT;
+    output_queue->poll_budget = VIRTQ_DEFAULT_POLL_BUDGET;
+    output_queue->idle_window = VIRTQ_DEFAULT_IDLE_WINDOW;
+    output_queue->last_activity = 0;
+    output_queue->interrupt_seen = device->interrupt_count;
+    output_queue->switches_to_poll = 0;
+    output_queue->switches_to_interrupt = 0;
+
+    output_queue->submit_time = submit_time;
+    output_queue->record_latency = true;
+
     virtq_init_free_list(output_queue);
 
+    // after the free list, so the in-use high water starts from an empty ring
+    virtq_reset_stats(output_queue);
+
     printf("virtq_init: freelist ok\n");
 
     mmio_write32(device->base, VIRTIO_MMIO_QUEUE_NUM, queue_size);
@@ -373,11 +412,17 @@ bool virtq_init(ViMMIODevice* device, uint32_t queue_index, uint16_t queue_size,
 
 int virtq_alloc_chain(ViQueue* queue, uint16_t count)
 {
-    if (!queue || count == 0 || queue->number_free < count) 
+    if (!queue || count == 0) 
     {
         return -1;
     }
 
+    if (queue->number_free < count)
+    {
+        queue->stats.ring_full++;
+        return -1;
+    }
+
     uint16_t head = 0xffffu;
     uint16_t previous = 0xffffu;
 
@@ -411,6 +456,13 @@ int virtq_alloc_chain(ViQueue* queue, uint16_t count)
     }
 
     queue->number_free = (uint16_t)(queue->number_free - count);
+
+    const uint16_t in_use = (uint16_t)(queue->queue_size - queue->number_free);
+    if (in_use > queue->stats.in_use_high_water)
+    {
+        queue->stats.in_use_high_water = in_use;
+    }
+
     return (int)head;
 }
 
@@ -453,6 +505,36 @@ void virtq_submit(ViQueue* queue, uint16_t head)
     fence_iorw();
     available->index = (uint16_t)(index + 1);
     fence_iorw();
+
+    if (head < queue->queue_size)
+    {
+        queue->submit_time[head] = (uint32_t)read_timestamp();
+    }
+    queue->stats.submits++;
+}
+
+void virtq_notify(ViQueue* queue)
+{
+    virtio_mmio_notify_queue(queue->device, queue->queue_index);
+    queue->stats.notifies++;
+}
+
+static void virtq_record_latency(ViQueue* queue, uint32_t ticks)
+{
+    ViQueueStats* stats = &queue->stats;
+
+    unsigned bucket = 0;
+    while ((ticks >> (bucket + 1)) != 0 && bucket < VIRTQ_LATENCY_BUCKETS - 1)
+    {
+        bucket++;
+    }
+
+    stats->latency_histogram[bucket]++;
+    stats->latency_total += ticks;
+    if (ticks > stats->latency_max)
+    {
+        stats->latency_max = ticks;
+    }
 }
 
 bool virtq_poll_used(ViQueue* queue, uint16_t* out_id)
@@ -464,12 +546,219 @@ bool virtq_poll_used(ViQueue* queue, uint16_t* out_id)
         return false;
     }
 
+    const uint16_t backlog = (uint16_t)(used_index - queue->last_used_index);
+    if (backlog > queue->stats.backlog_high_water)
+    {
+        queue->stats.backlog_high_water = backlog;
+    }
+
     VqConsumedElement element = used->ring[queue->last_used_index % queue->queue_size];
     queue->last_used_index = (uint16_t)(queue->last_used_index + 1);
 
+    queue->stats.completions++;
+    if (queue->record_latency && element.id < queue->queue_size)
+    {
+        virtq_record_latency(queue, (uint32_t)read_timestamp() - queue->submit_time[element.id]);
+    }
+
     if (out_id) 
     {
         *out_id = (uint16_t)element.id;
     }
     return true;
 }
+
+void virtq_set_mode(ViQueue* queue, ViQueueMode mode)
+{
+    volatile VqAvailable* available = (volatile VqAvailable*)queue->available;
+
+    if (mode == VIRTQ_MODE_POLL)
+    {
+        available->flags = (uint16_t)(available->flags | VIRTQ_AVAIL_F_NO_INTERRUPT);
+    }
+    else
+    {
+        available->flags = (uint16_t)(available->flags & ~VIRTQ_AVAIL_F_NO_INTERRUPT);
+    }
+    fence_iorw();
+
+    if (mode != queue->mode)
+    {
+        if (mode == VIRTQ_MODE_POLL)
+        {
+            queue->switches_to_poll++;
+        }
+        else
+        {
+            queue->switches_to_interrupt++;
+        }
+    }
+
+    queue->mode = mode;
+    queue->last_activity = (uint32_t)read_timestamp();
+}
+
+void virtq_set_adaptive(ViQueue* queue, uint16_t poll_budget, uint32_t idle_window)
+{
+    queue->poll_budget = (poll_budget == 0) ? 1u : poll_budget;
+    queue->idle_window = idle_window;
+}
+
+void virtq_set_record_latency(ViQueue* queue, bool record)
+{
+    queue->record_latency = record;
+}
+
+static bool virtq_has_used(ViQueue* queue)
+{
+    volatile VqConsumed* used = (volatile VqConsumed*)queue->used;
+    return used->index != queue->last_used_index;
+}
+
+static bool virtq_interrupt_pending(ViQueue* queue)
+{
+    // the status register is per device, so the ack is latched into a counter
+    // that each queue compares against its own snapshot
+    virtio_mmio_ack_interrupt(queue->device);
+
+    if (queue->interrupt_seen == queue->device->interrupt_count)
+    {
+        return false;
+    }
+
+    queue->interrupt_seen = queue->device->interrupt_count;
+    return true;
+}
+
+uint16_t virtq_adaptive_poll(ViQueue* queue, uint16_t* out_ids, uint16_t capacity)
+{
+    if (!queue || !out_ids || capacity == 0)
+    {
+        return 0;
+    }
+
+    if (queue->mode == VIRTQ_MODE_INTERRUPT)
+    {
+        if (!virtq_interrupt_pending(queue))
+        {
+            return 0;
+        }
+
+        // interrupt arrived: mask further ones and drain by polling
+        virtq_set_mode(queue, VIRTQ_MODE_POLL);
+    }
+
+    const uint16_t limit = (capacity < queue->poll_budget) ? capacity : queue->poll_budget;
+
+    uint16_t count = 0;
+    while (count < limit && virtq_poll_used(queue, &out_ids[count]))
+    {
+        count++;
+    }
+
+    const uint32_t now = (uint32_t)read_timestamp();
+
+    if (count != 0)
+    {
+        queue->last_activity = now;
+        return count;
+    }
+
+    if ((uint32_t)(now - queue->last_activity) < queue->idle_window)
+    {
+        return 0;
+    }
+
+    // ring stayed empty for the whole window: re-arm the interrupt, then look
+    // once more so a completion that raced the unmask is not stranded
+    virtq_set_mode(queue, VIRTQ_MODE_INTERRUPT);
+    queue->interrupt_seen = queue->device->interrupt_count;
+
+    if (virtq_has_used(queue))
+    {
+        virtq_set_mode(queue, VIRTQ_MODE_POLL);
+    }
+
+    return 0;
+}
+
+void virtq_get_stats(const ViQueue* queue, ViQueueStats* output_stats)
+{
+    if (!queue || !output_stats)
+    {
+        return;
+    }
+
+    *output_stats = queue->stats;
+}
+
+void virtq_reset_stats(ViQueue* queue)
+{
+    if (!queue)
+    {
+        return;
+    }
+
+    memset(&queue->stats, 0, sizeof(queue->stats));
+    queue->stats.in_use_high_water = (uint16_t)(queue->queue_size - queue->number_free);
+}
+
+void virtq_dump_stats(const ViQueue* queue, const char* name)
+{
+    if (!queue)
+    {
+        return;
+    }
+
+    const ViQueueStats* stats = &queue->stats;
+
+    printf("virtq %s: size=%u mode=%s to_poll=%u to_irq=%u\n",
+           name,
+           (unsigned)queue->queue_size,
+           (queue->mode == VIRTQ_MODE_POLL) ? "poll" : "irq",
+           (unsigned)queue->switches_to_poll,
+           (unsigned)queue->switches_to_interrupt);
+
+    printf("  submits=%u notifies=%u completions=%u ring_full=%u in_use_hwm=%u backlog_hwm=%u\n",
+           (unsigned)stats->submits,
+           (unsigned)stats->notifies,
+           (unsigned)stats->completions,
+           (unsigned)stats->ring_full,
+           (unsigned)stats->in_use_high_water,
+           (unsigned)stats->backlog_high_water);
+
+    if (!queue->record_latency)
+    {
+        printf("  latency: not recorded, the device fills this queue\n");
+        return;
+    }
+
+    if (stats->completions == 0)
+    {
+        return;
+    }
+
+    printf("  latency ticks: avg=%u max=%u (timer %u Hz)\n",
+           (unsigned)(stats->latency_total / stats->completions),
+           (unsigned)stats->latency_max,
+           (unsigned)PLATFORM_TIMER_HZ);
+
+    for (unsigned i = 0; i < VIRTQ_LATENCY_BUCKETS; i++)
+    {
+        if (stats->latency_histogram[i] == 0)
+        {
+            continue;
+        }
+
+        // bucket 0 starts at zero ticks; the last one has no upper bound
+        const unsigned low = (i == 0) ? 0u : (1u << i);
+        if (i == VIRTQ_LATENCY_BUCKETS - 1)
+        {
+            printf("    [%u,inf): %u\n", low, (unsigned)stats->latency_histogram[i]);
+        }
+        else
+        {
+            printf("    [%u,%u): %u\n", low, 1u << (i + 1), (unsigned)stats->latency_histogram[i]);
+        }
+    }
+}
@@ -5,21 +5,36 @@
 #include <stddef.h>
 #include <stdbool.h>
 
+#include "platform.h"
+
 typedef struct
 {
     uintptr_t base;
     uint32_t version;
+
+    // latched used-buffer interrupts, shared by every queue on the device
+    uint32_t interrupt_count;
+
+    // PLIC source wired to this transport
+    uint32_t irq;
 } ViMMIODevice;
 
+// InterruptStatus bits
+#define VIRTIO_MMIO_INT_VRING  1u
+#define VIRTIO_MMIO_INT_CONFIG 2u
+
 bool virtio_mmio_find_device(uint32_t device_id, ViMMIODevice* out_dev);
 bool virtio_mmio_init(ViMMIODevice* device);
 uint32_t virtio_mmio_read_device_features(ViMMIODevice* device, uint32_t sel);
 void virtio_mmio_write_driver_features(ViMMIODevice* device, uint32_t sel, uint32_t value);
 bool virtio_mmio_negotiate(ViMMIODevice* device, uint64_t wanted_features, uint64_t* out_accepted);
+uint32_t virtio_mmio_ack_interrupt(ViMMIODevice* device);
 
 #define VIRTQ_DESC_F_NEXT  1u
 #define VIRTQ_DESC_F_WRITE 2u
 
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 1u
+
 typedef struct
 {
     uint64_t address;
@@ -48,6 +63,32 @@ typedef struct
     VqConsumedElement ring[];
 } VqConsumed;
 
+// latency_histogram[i] counts completions whose submit-to-used time fell in
+// [2^i, 2^(i+1)) timer ticks; bucket 0 also holds zero-tick completions and
+// the last bucket absorbs everything longer
+#define VIRTQ_LATENCY_BUCKETS 24u
+
+typedef struct
+{
+    uint32_t submits;
+    uint32_t notifies;
+    uint32_t completions;
+    uint32_t ring_full;
+
+    uint16_t in_use_high_water;
+    uint16_t backlog_high_water;
+
+    uint32_t latency_max;
+    uint64_t latency_total;
+    uint32_t latency_histogram[VIRTQ_LATENCY_BUCKETS];
+} ViQueueStats;
+
+typedef enum
+{
+    VIRTQ_MODE_INTERRUPT = 0,
+    VIRTQ_MODE_POLL,
+} ViQueueMode;
+
 typedef struct
 {
     ViMMIODevice* device;
@@ -63,13 +104,48 @@ typedef struct
     uint16_t last_used_index;
 
     uint16_t* free_next;
+
+    uint32_t queue_index;
+
+    // NAPI-style completion handling: idle queues wait for the device to
+    // raise an interrupt, busy queues mask it and poll in budgeted passes
+    ViQueueMode mode;
+    uint16_t poll_budget;
+    uint32_t idle_window;
+    uint32_t last_activity;
+    uint32_t interrupt_seen;
+
+    uint32_t switches_to_poll;
+    uint32_t switches_to_interrupt;
+
+    // submit timestamp per descriptor head, for round-trip latency
+    uint32_t* submit_time;
+    ViQueueStats stats;
+
+    // off for queues the device fills at its own pace, like input events:
+    // there the time a buffer waits is idle time, not latency
+    bool record_latency;
 } ViQueue;
 
+#define VIRTQ_DEFAULT_POLL_BUDGET 16u
+// in timer ticks; comfortably longer than a keyboard autorepeat period
+#define VIRTQ_DEFAULT_IDLE_WINDOW (PLATFORM_TIMER_HZ / 20u)
+
 bool virtq_init(ViMMIODevice* device, uint32_t queue_index, uint16_t queue_size, ViQueue* out_q);
 int virtq_alloc_chain(ViQueue* q, uint16_t count);
 void virtq_free_chain(ViQueue* q, uint16_t head);
 void virtq_submit(ViQueue* q, uint16_t head);
 bool virtq_poll_used(ViQueue* q, uint16_t* out_id);
 void virtio_mmio_notify_queue(ViMMIODevice* device, uint32_t queue_index);
+void virtq_notify(ViQueue* q);
+
+void virtq_set_mode(ViQueue* q, ViQueueMode mode);
+void virtq_set_record_latency(ViQueue* q, bool record);
+void virtq_set_adaptive(ViQueue* q, uint16_t poll_budget, uint32_t idle_window);
+uint16_t virtq_adaptive_poll(ViQueue* q, uint16_t* out_ids, uint16_t capacity);
+
+void virtq_get_stats(const ViQueue* q, ViQueueStats* out_stats);
+void virtq_reset_stats(ViQueue* q);
+void virtq_dump_stats(const ViQueue* q, const char* name);
 
 #endif
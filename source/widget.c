@@ -0,0 +1,392 @@
+// Stratus: widget.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include "widget.h"
+
+#include "utility.h"
+#include "utf8.h"
+
+static inline uint8_t highlight_color(uint8_t color)
+{
+    return (uint8_t)(((color & 0x0Fu) << 4) | ((color & 0xF0u) >> 4));
+}
+
+// bytes at the front of text that fit in columns cells, one per codepoint
+static size_t fit_text(const char* text, size_t length, size_t columns, size_t* out_columns)
+{
+    size_t used = 0;
+    size_t bytes = 0;
+
+    while (bytes < length && used < columns)
+    {
+        uint32_t codepoint = 0;
+        bytes += utf8_next(&text[bytes], length - bytes, &codepoint);
+        used++;
+    }
+
+    *out_columns = used;
+    return bytes;
+}
+
+// one row of the widget: aligned text in text_color, padded out to the
+// widget's width with blanks in its own color
+static void paint_line(const Widget* widget, size_t y, const char* text, size_t length, uint8_t text_color)
+{
+    const size_t left = widget->rect.pos.x;
+    const size_t width = widget->rect.size.x;
+
+    size_t columns = 0;
+    const size_t bytes = fit_text(text, length, width, &columns);
+    const size_t offset = (widget->align == WIDGET_ALIGN_CENTER) ? (width - columns) / 2 : 0;
+
+    surface_fill_run(widget->surface, left, y, widget->color, ' ', offset);
+    surface_write_run(widget->surface, left + offset, y, text_color, text, bytes);
+    surface_fill_run(widget->surface, left + offset + columns, y, widget->color, ' ', width - offset - columns);
+}
+
+static void paint_blank(const Widget* widget)
+{
+    for (size_t y = 0; y < widget->rect.size.y; y++)
+    {
+        surface_fill_run(widget->surface, widget->rect.pos.x, widget->rect.pos.y + y, widget->color, ' ', widget->rect.size.x);
+    }
+}
+
+static void paint_groupbox(const Widget* widget)
+{
+    const Rect rect = widget->rect;
+    if (rect.size.x < 2 || rect.size.y < 2)
+    {
+        return;
+    }
+
+    const size_t left = rect.pos.x;
+    const size_t right = rect.pos.x + rect.size.x - 1;
+
+    const size_t top = rect.pos.y;
+    const size_t bottom = rect.pos.y + rect.size.y - 1;
+
+    static const uint32_t horizontal_line = 0x2500;
+    static const uint32_t vertical_line = 0x2502;
+
+    static const uint32_t top_left_corner = 0x250C;
+    static const uint32_t top_right_corner = 0x2510;
+    static const uint32_t bottom_left_corner = 0x2514;
+    static const uint32_t bottom_right_corner = 0x2518;
+
+    Surface* surface = widget->surface;
+    const uint8_t color = widget->color;
+
+    // draw top and bottom lines
+    surface_fill_run(surface, left, top, color, horizontal_line, rect.size.x);
+    surface_fill_run(surface, left, bottom, color, horizontal_line, rect.size.x);
+
+    // draw left and right lines
+    for (size_t y = top; y <= bottom; y++)
+    {
+        surface_putcodepointat(surface, vertical_line, color, left, y);
+        surface_putcodepointat(surface, vertical_line, color, right, y);
+    }
+
+    // draw corners properly
+    surface_putcodepointat(surface, top_left_corner, color, left, top);
+    surface_putcodepointat(surface, top_right_corner, color, right, top);
+    surface_putcodepointat(surface, bottom_left_corner, color, left, bottom);
+    surface_putcodepointat(surface, bottom_right_corner, color, right, bottom);
+
+    // the title sits on the top line, two cells in from either corner
+    if (widget->text && rect.size.x > 4)
+    {
+        size_t columns = 0;
+        const size_t bytes = fit_text(widget->text, strlen(widget->text), rect.size.x - 4, &columns);
+        surface_write_run(surface, left + 2, top, widget->focused ? highlight_color(color) : color, widget->text, bytes);
+    }
+}
+
+static void paint_text_view(const Widget* widget)
+{
+    const char* text = widget->text ? widget->text : "";
+
+    // one row per line, broken at newlines and at the right edge
+    for (size_t y = 0; y < widget->rect.size.y; y++)
+    {
+        size_t length = 0;
+        while (text[length] && text[length] != '\n')
+        {
+            length++;
+        }
+
+        size_t columns = 0;
+        const size_t bytes = fit_text(text, length, widget->rect.size.x, &columns);
+        paint_line(widget, widget->rect.pos.y + y, text, bytes, widget->color);
+
+        text += bytes;
+        if (*text == '\n')
+        {
+            text++;
+        }
+    }
+}
+
+static void paint_list_row(Widget* list, size_t index)
+{
+    if (index >= list->rect.size.y)
+    {
+        return;
+    }
+
+    const size_t y = list->rect.pos.y + index;
+
+    if (index >= list->item_count || !list->items[index])
+    {
+        paint_line(list, y, "", 0, list->color);
+        return;
+    }
+
+    const bool highlighted = list->focused && index == list->selected;
+    const char* item = list->items[index];
+    paint_line(list, y, item, strlen(item), highlighted ? highlight_color(list->color) : list->color);
+}
+
+static void paint_list(Widget* list)
+{
+    for (size_t i = 0; i < list->rect.size.y; i++)
+    {
+        paint_list_row(list, i);
+    }
+
+    list->painted_selected = list->selected;
+    list->painted_focused = list->focused;
+}
+
+// repaints only the rows whose highlight changed since the last paint
+static void paint_list_changes(Widget* list)
+{
+    if (list->painted_selected == list->selected && list->painted_focused == list->focused)
+    {
+        return;
+    }
+
+    const size_t previous = list->painted_selected;
+    list->painted_selected = list->selected;
+    list->painted_focused = list->focused;
+
+    paint_list_row(list, previous);
+    if (list->selected != previous)
+    {
+        paint_list_row(list, list->selected);
+    }
+}
+
+static void paint_widget(Widget* widget)
+{
+    if (!widget->surface)
+    {
+        return;
+    }
+
+    // a hidden widget leaves blank space behind, children included
+    if (!widget->visible)
+    {
+        paint_blank(widget);
+        return;
+    }
+
+    switch (widget->type)
+    {
+        case WIDGET_GROUPBOX:
+            paint_groupbox(widget);
+            break;
+        case WIDGET_LABEL:
+        {
+            const char* text = widget->text ? widget->text : "";
+            paint_line(widget, widget->rect.pos.y, text, strlen(text), widget->color);
+        } break;
+        case WIDGET_LIST:
+            paint_list(widget);
+            break;
+        case WIDGET_TEXT_VIEW:
+            paint_text_view(widget);
+            break;
+        default:
+            break;
+    }
+}
+
+// flags the path from the root down to widget for the next render
+static void widget_schedule(Widget* widget)
+{
+    for (Widget* parent = widget->parent; parent && !parent->child_dirty; parent = parent->parent)
+    {
+        parent->child_dirty = true;
+    }
+}
+
+void widget_init(Widget* widget, WidgetType type, Surface* surface, Rect rect, uint8_t color)
+{
+    memset(widget, 0, sizeof(*widget));
+
+    widget->type = type;
+    widget->surface = surface;
+    widget->rect = rect;
+    widget->color = color;
+    widget->visible = true;
+    widget->dirty = true;
+}
+
+void widget_add_child(Widget* parent, Widget* child)
+{
+    child->parent = parent;
+    child->next = 0;
+
+    Widget** link = &parent->children;
+    while (*link)
+    {
+        link = &(*link)->next;
+    }
+    *link = child;
+
+    if (!child->surface)
+    {
+        child->surface = parent->surface;
+    }
+
+    widget_invalidate(child);
+}
+
+void widget_invalidate(Widget* widget)
+{
+    widget->dirty = true;
+    widget_schedule(widget);
+}
+
+void widget_set_rect(Widget* widget, Rect rect)
+{
+    if (widget->rect.pos.x == rect.pos.x && widget->rect.pos.y == rect.pos.y &&
+        widget->rect.size.x == rect.size.x && widget->rect.size.y == rect.size.y)
+    {
+        return;
+    }
+
+    // clear the old spot; the new one is painted on the next render
+    if (widget->surface && widget->visible)
+    {
+        paint_blank(widget);
+    }
+
+    widget->rect = rect;
+    widget_invalidate(widget);
+}
+
+void widget_set_color(Widget* widget, uint8_t color)
+{
+    if (widget->color != color)
+    {
+        widget->color = color;
+        widget_invalidate(widget);
+    }
+}
+
+void widget_set_visible(Widget* widget, bool visible)
+{
+    if (widget->visible != visible)
+    {
+        widget->visible = visible;
+        widget_invalidate(widget);
+    }
+}
+
+void widget_set_text(Widget* widget, const char* text)
+{
+    if (widget->text == text || (widget->text && text && strcmp(widget->text, text) == 0))
+    {
+        widget->text = text;
+        return;
+    }
+
+    widget->text = text;
+    widget_invalidate(widget);
+}
+
+void widget_set_align(Widget* widget, WidgetAlign align)
+{
+    if (widget->align != align)
+    {
+        widget->align = align;
+        widget_invalidate(widget);
+    }
+}
+
+void widget_set_focused(Widget* widget, bool focused)
+{
+    if (widget->focused == focused)
+    {
+        return;
+    }
+
+    widget->focused = focused;
+
+    if (widget->type == WIDGET_LIST)
+    {
+        widget_schedule(widget);
+    }
+    else
+    {
+        widget_invalidate(widget);
+    }
+}
+
+void list_set_items(Widget* list, const char* const* items, size_t count)
+{
+    list->items = items;
+    list->item_count = count;
+    widget_invalidate(list);
+}
+
+void list_set_selection(Widget* list, size_t index)
+{
+    if (list->selected != index)
+    {
+        list->selected = index;
+        widget_schedule(list);
+    }
+}
+
+static void render_widget(Widget* widget, bool force)
+{
+    if (force || widget->dirty)
+    {
+        paint_widget(widget);
+        force = true;
+    }
+    else if (widget->type == WIDGET_LIST && widget->visible)
+    {
+        paint_list_changes(widget);
+    }
+
+    widget->dirty = false;
+
+    // a hidden widget's children stay flagged until it is shown again
+    if (!widget->visible)
+    {
+        return;
+    }
+
+    if (force || widget->child_dirty)
+    {
+        for (Widget* child = widget->children; child; child = child->next)
+        {
+            render_widget(child, force);
+        }
+    }
+
+    widget->child_dirty = false;
+}
+
+void widget_render(Widget* root)
+{
+    if (root && root->surface)
+    {
+        render_widget(root, false);
+    }
+}
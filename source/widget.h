@@ -0,0 +1,89 @@
+#ifndef STRATUS_WIDGET_H
+#define STRATUS_WIDGET_H
+
+// Stratus: widget.h
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "defs.h"
+#include "surface.h"
+
+typedef enum
+{
+    WIDGET_GROUPBOX,
+    WIDGET_LABEL,
+    WIDGET_LIST,
+    WIDGET_TEXT_VIEW,
+} WidgetType;
+
+typedef enum
+{
+    WIDGET_ALIGN_LEFT,
+    WIDGET_ALIGN_CENTER,
+} WidgetAlign;
+
+// Retained UI element. Widgets keep their own state and only paint into
+// their surface when it changes: setters that change something invalidate
+// the widget, and widget_render repaints just the invalidated ones. A group
+// box paints its border and title and leaves its inside to its children.
+typedef struct Widget
+{
+    WidgetType type;
+    Surface* surface;
+    // in surface coordinates; a group box's border runs along the edge
+    Rect rect;
+    uint8_t color;
+    bool visible;
+
+    // label and text view contents, or a group box's title
+    const char* text;
+    WidgetAlign align;
+
+    // list rows, one item each; the selected row is highlighted while the
+    // list has focus. A group box with focus highlights its title.
+    const char* const* items;
+    size_t item_count;
+    size_t selected;
+    bool focused;
+
+    struct Widget* parent;
+    struct Widget* children;
+    struct Widget* next;
+
+    // dirty repaints the widget and everything under it; child_dirty only
+    // means something further down has to be visited
+    bool dirty;
+    bool child_dirty;
+
+    // what the list looked like when last painted, so a selection change
+    // repaints just the two rows involved
+    size_t painted_selected;
+    bool painted_focused;
+} Widget;
+
+// Resets the widget to a visible, empty one with no children.
+void widget_init(Widget* widget, WidgetType type, Surface* surface, Rect rect, uint8_t color);
+// Children are painted after, and so on top of, their parent.
+void widget_add_child(Widget* parent, Widget* child);
+
+void widget_invalidate(Widget* widget);
+
+// Setters only invalidate when the value actually changes. Text is kept by
+// pointer; after editing it in place, call widget_invalidate.
+void widget_set_rect(Widget* widget, Rect rect);
+void widget_set_color(Widget* widget, uint8_t color);
+void widget_set_visible(Widget* widget, bool visible);
+void widget_set_text(Widget* widget, const char* text);
+void widget_set_align(Widget* widget, WidgetAlign align);
+void widget_set_focused(Widget* widget, bool focused);
+
+void list_set_items(Widget* list, const char* const* items, size_t count);
+void list_set_selection(Widget* list, size_t index);
+
+// Paints whatever changed in the tree under root into its surfaces.
+void widget_render(Widget* root);
+
+#endif
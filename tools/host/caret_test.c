@@ -0,0 +1,104 @@
+// Stratus: caret_test.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+// The software caret at 8x16: what a blink costs, and that redraws, scrolls
+// and moves leave no stray underline behind.
+
+#include <stdio.h>
+
+#include "fb_console.h"
+#include "display_model.h"
+
+// cell 0x17 is light grey on blue; the caret XORs the background
+#define BACKGROUND 0x000000AAu
+#define CARET      (BACKGROUND ^ 0x00FFFFFFu)
+
+static int _failures;
+
+static void expect(bool condition, const char* what)
+{
+    if (!condition)
+    {
+        fprintf(stdout, "FAILED: %s\n", what);
+        _failures++;
+    }
+}
+
+// bottom pixel row of a cell, where the underline goes
+static uint32_t underline(uint32_t column, uint32_t row)
+{
+    return display_model_pixel(0, column * 8u + 1u, row * 16u + 15u);
+}
+
+// ticks until the blink presents something, up to a limit
+static void wait_for_blink(void)
+{
+    const uint32_t presents = display_model_presents();
+    for (int i = 0; i < 1000 && display_model_presents() == presents; i++)
+    {
+        terminal_frame_tick();
+    }
+}
+
+int main(void)
+{
+    terminal_initialize();
+    expect(terminal_get_font()->width == 8u && terminal_get_font()->height == 16u, "8x16 font at 640x480");
+
+    // every tick is a frame, and the host clock moves 100 ticks per read, so
+    // a 1ms blink comes around every hundred or so frames
+    terminal_set_refresh_rate(0);
+    terminal_set_caret_blink(1);
+
+    for (size_t y = 0; y < 8; y++)
+    {
+        terminal_fill_run(0, y, 0x17, ' ', 20);
+    }
+    terminal_putentryat('A', 0x17, 5, 3);
+    terminal_set_caret(5, 3);
+    terminal_show_caret(true);
+    terminal_flush();
+    expect(underline(5, 3) == CARET, "caret shown");
+
+    uint32_t presents = display_model_presents();
+    uint32_t rects = display_model_rect_count();
+    wait_for_blink();
+    expect(display_model_presents() == presents + 1u, "a blink is one submission");
+    expect(display_model_rect_count() == rects + 1u, "a blink is one rect");
+
+    const DisplayModelRect* rect = display_model_rect(rects);
+    expect(rect && rect->rect.x == 40u && rect->rect.y == 62u && rect->rect.width == 8u && rect->rect.height == 2u,
+           "the rect is the 8x2 underline");
+    expect(underline(5, 3) == BACKGROUND, "blinked off");
+
+    wait_for_blink();
+    expect(underline(5, 3) == CARET, "blinked back on");
+
+    terminal_putentryat('B', 0x17, 5, 3);
+    terminal_flush();
+    expect(underline(5, 3) == CARET, "caret survives a redraw of its cell");
+
+    terminal_scroll_region(RECT(POINT(0, 2), POINT(20, 4)), 1, 0x17);
+    terminal_flush();
+    expect(underline(5, 3) == CARET, "caret stays put through a scroll");
+    expect(underline(5, 2) == BACKGROUND, "scroll does not carry the caret");
+
+    terminal_set_caret(6, 3);
+    terminal_flush();
+    expect(underline(5, 3) == BACKGROUND, "old spot cleared after a move");
+    expect(underline(6, 3) == CARET, "shown at the new spot");
+
+    terminal_show_caret(false);
+    terminal_flush();
+    expect(underline(6, 3) == BACKGROUND, "hidden");
+
+    presents = display_model_presents();
+    for (int i = 0; i < 300; i++)
+    {
+        terminal_frame_tick();
+    }
+    expect(display_model_presents() == presents, "a hidden caret costs nothing");
+
+    fprintf(stdout, "caret: %s\n", _failures == 0 ? "ok" : "FAILED");
+    return _failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+// Stratus: color_bench.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+// Rewrites the whole screen in 8-cell runs with a new color per run, using
+// attribute bytes, the same colors as palette indices, 256-color cells and
+// 24-bit cells. Prints the best of five timings for each and checks that the
+// byte calls draw exactly what the matching palette entries do.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "fb_console.h"
+#include "display_model.h"
+
+#define FRAMES 300
+#define REPEATS 5
+#define RUN 8u
+
+typedef enum
+{
+    MODE_ATTRIBUTE,
+    MODE_PALETTE_16,
+    MODE_PALETTE_256,
+    MODE_RGB,
+    MODE_COUNT,
+} ColorMode;
+
+static const char* const _names[MODE_COUNT] = { "attribute", "palette-16", "256-color", "rgb" };
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static void draw_frame(ColorMode mode, int frame, size_t columns, size_t rows)
+{
+    char line[256];
+    for (size_t y = 0; y < rows; y++)
+    {
+        for (size_t x = 0; x < columns; x++)
+        {
+            line[x] = (char)('A' + (x + y + frame) % 26);
+        }
+
+        for (size_t x = 0; x < columns; x += RUN)
+        {
+            const size_t count = (x + RUN <= columns) ? RUN : columns - x;
+            const uint8_t color = (uint8_t)(0x10 + (x / RUN + y + frame) % 7);
+
+            switch (mode)
+            {
+                case MODE_ATTRIBUTE:
+                    terminal_write_run(x, y, color, &line[x], count);
+                    break;
+                case MODE_PALETTE_16:
+                    terminal_write_run_color(x, y, terminal_attribute_fg(color), terminal_attribute_bg(color), &line[x], count);
+                    break;
+                case MODE_PALETTE_256:
+                    terminal_write_run_color(x, y, 16u + (x / RUN + y + frame) % 200u, 232u + y % 24u, &line[x], count);
+                    break;
+                default:
+                    terminal_write_run_color(x, y, TERMINAL_RGB(x & 0xff, (y * 4u) & 0xff, frame & 0xff), TERMINAL_RGB(0, 0, (x / RUN) & 0xff), &line[x], count);
+                    break;
+            }
+        }
+    }
+    terminal_flush();
+}
+
+int main(void)
+{
+    terminal_initialize();
+
+    size_t columns, rows;
+    terminal_get_size(&columns, &rows);
+
+    uint64_t hashes[MODE_COUNT];
+    for (int mode = 0; mode < MODE_COUNT; mode++)
+    {
+        double best = 1e9;
+        for (int repeat = 0; repeat < REPEATS; repeat++)
+        {
+            const double start = seconds();
+            for (int frame = 0; frame < FRAMES; frame++)
+            {
+                draw_frame((ColorMode)mode, frame, columns, rows);
+            }
+
+            const double spent = seconds() - start;
+            if (spent < best)
+            {
+                best = spent;
+            }
+        }
+
+        hashes[mode] = display_model_hash(0);
+        fprintf(stdout, "%-10s best of %d: %.3fs for %d frames\n", _names[mode], REPEATS, best, FRAMES);
+    }
+
+    const bool same = hashes[MODE_ATTRIBUTE] == hashes[MODE_PALETTE_16];
+    fprintf(stdout, "attribute colors: %s\n", same ? "ok" : "FAILED");
+    return same ? 0 : 1;
+}
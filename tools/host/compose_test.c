@@ -0,0 +1,138 @@
+// Stratus: compose_test.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+// Random writes, fills, scrolls and composes over two surfaces; after every
+// compose the screen must hold exactly what the surfaces do. Then checks what
+// a small change costs once composed.
+
+#include <stdio.h>
+
+#include "fb_console.h"
+#include "surface.h"
+#include "display_model.h"
+
+#define OPERATIONS 20000
+
+// a damage tile is 64x32 pixels
+#define TILE_BYTES (64u * 32u * 4u)
+
+static uint32_t _seed = 1u;
+
+static uint32_t next_random(uint32_t bound)
+{
+    _seed = _seed * 1103515245u + 12345u;
+    return (_seed >> 8) % bound;
+}
+
+// cells that differ between the screen and the surface
+static int compare(const Surface* surface, const char* name)
+{
+    int differences = 0;
+    for (size_t y = 0; y < surface->rect.size.y; y++)
+    {
+        for (size_t x = 0; x < surface->rect.size.x; x++)
+        {
+            char c;
+            uint8_t color;
+            terminal_getentryat(surface->rect.pos.x + x, surface->rect.pos.y + y, &c, &color);
+
+            const TerminalCell* cell = &surface->cells[y * surface->rect.size.x + x];
+            const uint8_t wanted = (uint8_t)((cell->bg << 4) | cell->fg);
+            if (c != (char)cell->codepoint || color != wanted)
+            {
+                if (differences == 0)
+                {
+                    fprintf(stdout, "%s: screen has %c/%02x at %zu,%zu, surface %c/%02x\n",
+                            name, c, color, x, y, (char)cell->codepoint, wanted);
+                }
+                differences++;
+            }
+        }
+    }
+    return differences;
+}
+
+static void random_operation(Surface* surface)
+{
+    const uint32_t operation = next_random(10);
+    if (operation < 5)
+    {
+        char text[16];
+        const uint32_t length = next_random(12);
+        for (uint32_t i = 0; i < length; i++)
+        {
+            text[i] = (char)('a' + next_random(26));
+        }
+        surface_write_run(surface, next_random(35), next_random(14), (uint8_t)next_random(256), text, length);
+    }
+    else if (operation < 6)
+    {
+        surface_fill_run(surface, next_random(35), next_random(14), (uint8_t)next_random(256), '#', next_random(40));
+    }
+    else if (operation < 8)
+    {
+        // mostly the inner region, like a console pane, sometimes anything
+        const int32_t lines = (int32_t)next_random(7) - 3;
+        Rect region = RECT(POINT(1, 1), POINT(surface->rect.size.x - 2, surface->rect.size.y - 2));
+        if (next_random(3) == 0)
+        {
+            region = RECT(POINT(next_random(5), next_random(5)), POINT(1 + next_random(30), 1 + next_random(12)));
+        }
+        surface_scroll(surface, region, lines, (uint8_t)next_random(256));
+    }
+    else if (next_random(4) == 0)
+    {
+        terminal_flush();
+    }
+}
+
+int main(void)
+{
+    terminal_initialize();
+
+    Surface a = { 0 };
+    Surface b = { 0 };
+    surface_init(&a, RECT(POINT(3, 2), POINT(30, 12)), 0x17);
+    surface_init(&b, RECT(POINT(40, 2), POINT(20, 10)), 0x1E);
+    compositor_add(&a);
+    compositor_add(&b);
+    compositor_compose();
+
+    int failures = 0;
+    for (int i = 0; i < OPERATIONS && failures == 0; i++)
+    {
+        if (next_random(10) == 0)
+        {
+            compositor_compose();
+            failures += compare(&a, "a") + compare(&b, "b");
+            if (failures)
+            {
+                fprintf(stdout, "after operation %d\n", i);
+            }
+            continue;
+        }
+
+        random_operation(next_random(2) ? &a : &b);
+    }
+
+    compositor_compose();
+    failures += compare(&a, "a") + compare(&b, "b");
+
+    // one changed cell in a large surface is one damage tile
+    terminal_flush();
+    const uint32_t rects = display_model_rect_count();
+    surface_write_run(&a, 5, 5, 0x17, "Z", 1);
+    compositor_compose();
+    terminal_flush();
+
+    TerminalFlushStats stats;
+    terminal_get_flush_stats(&stats);
+    if (display_model_rect_count() != rects + 1u || stats.last_bytes != TILE_BYTES)
+    {
+        fprintf(stdout, "one cell cost %u rects and %u bytes\n", display_model_rect_count() - rects, stats.last_bytes);
+        failures++;
+    }
+
+    fprintf(stdout, "compose: %s\n", failures == 0 ? "ok" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+// Stratus: display_model.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "display_model.h"
+
+#define MODEL_HEADS 2u
+#define MODEL_LOG 256u
+
+typedef struct
+{
+    FramebufferInfo framebuffer;
+    uint32_t** buffers[2];
+    uint32_t back;
+} ModelHead;
+
+static const uint32_t _widths[MODEL_HEADS] = { 640u, 320u };
+static const uint32_t _heights[MODEL_HEADS] = { 480u, 240u };
+
+static ModelHead _heads[MODEL_HEADS];
+
+static uint32_t _presents;
+static uint32_t _rect_count;
+static DisplayModelRect _log[MODEL_LOG];
+
+static uint32_t** model_rows(uint32_t width, uint32_t height)
+{
+    uint32_t** rows = calloc(height, sizeof(uint32_t*));
+    for (uint32_t y = 0; y < height; y++)
+    {
+        rows[y] = calloc(width, sizeof(uint32_t));
+    }
+    return rows;
+}
+
+bool virtio_gpu_init(void)
+{
+    for (uint32_t i = 0; i < MODEL_HEADS; i++)
+    {
+        ModelHead* head = &_heads[i];
+        head->buffers[0] = model_rows(_widths[i], _heights[i]);
+        head->buffers[1] = model_rows(_widths[i], _heights[i]);
+        head->back = 1;
+
+        head->framebuffer.rows = head->buffers[1];
+        head->framebuffer.width = _widths[i];
+        head->framebuffer.height = _heights[i];
+        head->framebuffer.stride_bytes = _widths[i] * 4u;
+    }
+    return true;
+}
+
+uint32_t virtio_gpu_scanout_count(void)
+{
+    return MODEL_HEADS;
+}
+
+bool virtio_gpu_get_scanout(uint32_t scanout, FramebufferInfo* out_fb)
+{
+    if (scanout >= MODEL_HEADS)
+    {
+        return false;
+    }
+
+    *out_fb = _heads[scanout].framebuffer;
+    return true;
+}
+
+bool virtio_gpu_present(const FramebufferPresent* presents, size_t count)
+{
+    _presents++;
+
+    for (size_t p = 0; p < count; p++)
+    {
+        ModelHead* head = &_heads[presents[p].scanout];
+        uint32_t** front = head->buffers[head->back];
+        uint32_t** back = head->buffers[head->back ^ 1u];
+
+        for (size_t i = 0; i < presents[p].count; i++)
+        {
+            const FramebufferRect* rect = &presents[p].damage[i];
+            if (_rect_count < MODEL_LOG)
+            {
+                _log[_rect_count].scanout = presents[p].scanout;
+                _log[_rect_count].rect = *rect;
+            }
+            _rect_count++;
+
+            for (uint32_t y = rect->y; y < rect->y + rect->height; y++)
+            {
+                memcpy(&back[y][rect->x], &front[y][rect->x], rect->width * 4u);
+            }
+        }
+
+        head->back ^= 1u;
+        head->framebuffer.rows = head->buffers[head->back];
+        if (presents[p].out_back)
+        {
+            *presents[p].out_back = head->framebuffer;
+        }
+    }
+    return true;
+}
+
+// the copy-forward above is done eagerly
+void virtio_gpu_prepare_back(uint32_t scanout)
+{
+    (void)scanout;
+}
+
+uint32_t virtio_gpu_poll_resize(void)
+{
+    return 0;
+}
+
+bool virtio_gpu_cursor_available(void)
+{
+    return false;
+}
+
+bool virtio_gpu_cursor_define(const uint32_t* argb, uint32_t width, uint32_t height, uint32_t hot_x, uint32_t hot_y)
+{
+    (void)argb;
+    (void)width;
+    (void)height;
+    (void)hot_x;
+    (void)hot_y;
+    return false;
+}
+
+bool virtio_gpu_cursor_move(uint32_t scanout, uint32_t x, uint32_t y)
+{
+    (void)scanout;
+    (void)x;
+    (void)y;
+    return false;
+}
+
+bool virtio_gpu_cursor_show(bool visible)
+{
+    (void)visible;
+    return false;
+}
+
+uint32_t display_model_presents(void)
+{
+    return _presents;
+}
+
+uint32_t display_model_rect_count(void)
+{
+    return _rect_count;
+}
+
+const DisplayModelRect* display_model_rect(uint32_t index)
+{
+    return (index < MODEL_LOG && index < _rect_count) ? &_log[index] : (const DisplayModelRect*)0;
+}
+
+uint32_t display_model_pixel(uint32_t scanout, uint32_t x, uint32_t y)
+{
+    const ModelHead* head = &_heads[scanout];
+    return head->buffers[head->back ^ 1u][y][x];
+}
+
+uint64_t display_model_hash(uint32_t scanout)
+{
+    const ModelHead* head = &_heads[scanout];
+    uint64_t hash = 1469598103934665603ull;
+    for (uint32_t y = 0; y < head->framebuffer.height; y++)
+    {
+        for (uint32_t x = 0; x < head->framebuffer.width; x++)
+        {
+            hash = (hash ^ head->buffers[head->back ^ 1u][y][x]) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
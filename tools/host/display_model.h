@@ -0,0 +1,32 @@
+#ifndef STRATUS_DISPLAY_MODEL_H
+#define STRATUS_DISPLAY_MODEL_H
+
+// Stratus: display_model.h
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include <stdint.h>
+
+#include "virtio_gpu.h"
+
+// Stands in for the whole GPU driver below the console: two heads, 640x480
+// and 320x240, each double-buffered in host memory with the same flip and
+// copy-forward as the driver. There is no hardware cursor. Every present is
+// logged so tests can see what the console sent.
+
+typedef struct
+{
+    uint32_t scanout;
+    FramebufferRect rect;
+} DisplayModelRect;
+
+// virtio_gpu_present calls, and the damage rects they carried
+uint32_t display_model_presents(void);
+uint32_t display_model_rect_count(void);
+// the first 256 rects are kept
+const DisplayModelRect* display_model_rect(uint32_t index);
+
+// What the head shows after its last present.
+uint32_t display_model_pixel(uint32_t scanout, uint32_t x, uint32_t y);
+uint64_t display_model_hash(uint32_t scanout);
+
+#endif
@@ -0,0 +1,69 @@
+// Stratus: host_platform.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+// The few kernel services the sources under test link against, backed by the
+// host C library. Console output goes to stderr so it stays out of the way
+// of the harness results on stdout.
+
+#define printf libc_printf
+#define putchar libc_putchar
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#undef printf
+#undef putchar
+
+void printf(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+void putchar(char c)
+{
+    fputc(c, stderr);
+}
+
+size_t max(size_t x, size_t y)
+{
+    return x > y ? x : y;
+}
+
+size_t min(size_t x, size_t y)
+{
+    return x < y ? x : y;
+}
+
+void memory_init(void)
+{
+}
+
+// fresh memory is filled with garbage, as it would be on the target
+void* kmalloc_aligned(size_t size, size_t align)
+{
+    if (align < 16)
+    {
+        align = 16;
+    }
+
+    void* memory;
+    if (posix_memalign(&memory, align, size ? size : 1u) != 0)
+    {
+        return (void*)0;
+    }
+
+    memset(memory, 0xcd, size);
+    return memory;
+}
+
+// a clock that advances a little on every read
+int read_timestamp(void)
+{
+    static int now;
+    now += 100;
+    return now;
+}
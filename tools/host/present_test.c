@@ -0,0 +1,171 @@
+// Stratus: present_test.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+// Runs the real driver against the device model and checks, after presents,
+// that every head shows exactly what was drawn. Usage: present_test [2d|blob]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "virtio_gpu.h"
+#include "virtio_gpu_device.h"
+
+#define HEADS 2u
+#define FRAMES 400u
+
+static uint32_t _widths[HEADS] = { 320u, 200u };
+static uint32_t _heights[HEADS] = { 200u, 120u };
+
+// what each head should show, kept apart from the driver's buffers
+static uint32_t* _expected[HEADS];
+static FramebufferInfo _back[HEADS];
+
+static uint32_t _seed = 12345u;
+
+static uint32_t next_random(uint32_t bound)
+{
+    _seed = _seed * 1103515245u + 12345u;
+    return (_seed >> 8) % bound;
+}
+
+static void draw_rect(uint32_t head, const FramebufferRect* rect, uint32_t color)
+{
+    virtio_gpu_prepare_back(head);
+
+    for (uint32_t y = rect->y; y < rect->y + rect->height; y++)
+    {
+        for (uint32_t x = rect->x; x < rect->x + rect->width; x++)
+        {
+            _back[head].rows[y][x] = color;
+            _expected[head][y * _back[head].width + x] = color;
+        }
+    }
+}
+
+static FramebufferRect random_rect(uint32_t head)
+{
+    FramebufferRect rect;
+    rect.width = 1u + next_random(_back[head].width / 3u);
+    rect.height = 1u + next_random(_back[head].height / 3u);
+    rect.x = next_random(_back[head].width - rect.width + 1u);
+    rect.y = next_random(_back[head].height - rect.height + 1u);
+    return rect;
+}
+
+// a new mode starts with a cleared screen
+static void reset_head(uint32_t head)
+{
+    virtio_gpu_get_scanout(head, &_back[head]);
+    free(_expected[head]);
+    _expected[head] = calloc((size_t)_back[head].width * _back[head].height, 4u);
+
+    FramebufferRect all = { 0, 0, _back[head].width, _back[head].height };
+    draw_rect(head, &all, 0);
+
+    FramebufferPresent present = { head, &all, 1, &_back[head] };
+    virtio_gpu_present(&present, 1);
+}
+
+static bool check_head(uint32_t head, uint32_t frame)
+{
+    for (uint32_t y = 0; y < _back[head].height; y++)
+    {
+        for (uint32_t x = 0; x < _back[head].width; x++)
+        {
+            uint32_t shown;
+            if (!gpu_device_pixel(head, x, y, &shown))
+            {
+                fprintf(stdout, "frame %u: head %u has no pixel at %u,%u\n", frame, head, x, y);
+                return false;
+            }
+
+            const uint32_t wanted = _expected[head][y * _back[head].width + x];
+            if (shown != wanted)
+            {
+                fprintf(stdout, "frame %u: head %u shows %08x at %u,%u, drew %08x\n", frame, head, shown, x, y, wanted);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const bool blob = argc > 1 && strcmp(argv[1], "blob") == 0;
+
+    gpu_device_configure(HEADS, _widths, _heights, blob);
+    if (!virtio_gpu_init())
+    {
+        fprintf(stdout, "init failed\n");
+        return 1;
+    }
+
+    for (uint32_t head = 0; head < HEADS; head++)
+    {
+        reset_head(head);
+    }
+
+    uint32_t failures = 0;
+    for (uint32_t frame = 0; frame < FRAMES && failures == 0; frame++)
+    {
+        if (frame == FRAMES / 2u)
+        {
+            gpu_device_set_mode(1, 240, 160);
+            if (virtio_gpu_poll_resize() != 2u)
+            {
+                fprintf(stdout, "resize not picked up\n");
+                return 1;
+            }
+            reset_head(1);
+        }
+
+        FramebufferRect damage[HEADS][VIRTIO_GPU_MAX_PRESENT_RECTS];
+        FramebufferPresent presents[HEADS];
+        for (uint32_t head = 0; head < HEADS; head++)
+        {
+            // now and then more damage than a present takes in one go
+            const uint32_t count = (frame % 37u == 0) ? VIRTIO_GPU_MAX_PRESENT_RECTS : 1u + next_random(4);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                damage[head][i] = random_rect(head);
+                draw_rect(head, &damage[head][i], next_random(0xffffffu) | 0xff000000u);
+            }
+
+            presents[head].scanout = head;
+            presents[head].damage = damage[head];
+            presents[head].count = count;
+            presents[head].out_back = &_back[head];
+        }
+
+        if (!virtio_gpu_present(presents, HEADS))
+        {
+            fprintf(stdout, "frame %u: present failed\n", frame);
+            failures++;
+        }
+
+        // presenting must not wait for the frame it just sent
+        if (gpu_device_pending() == 0)
+        {
+            fprintf(stdout, "frame %u: present waited for its own flush\n", frame);
+            failures++;
+        }
+
+        // every other frame the device is left behind while the next one is
+        // drawn
+        if (frame % 2u == 1u)
+        {
+            virtio_gpu_wait(0);
+            gpu_device_drain();
+            for (uint32_t head = 0; head < HEADS; head++)
+            {
+                failures += check_head(head, frame) ? 0u : 1u;
+            }
+        }
+    }
+
+    failures += gpu_device_errors() + virtio_gpu_error_count();
+    fprintf(stdout, "%s: %s\n", blob ? "blob" : "2d", failures == 0 ? "ok" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+// Stratus: run_bench.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+// Rewrites the whole screen every frame, once a cell at a time and once in
+// runs, and checks both produce the same pixels. Prints how long each took.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "fb_console.h"
+#include "display_model.h"
+
+#define FRAMES 300
+#define SAMPLE_EVERY 25
+
+static uint64_t _samples[FRAMES / SAMPLE_EVERY];
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// returns how many sampled frames differed from the first pass
+static int rewrite(bool runs, double* out_seconds)
+{
+    size_t columns, rows;
+    terminal_get_size(&columns, &rows);
+
+    char line[256];
+    int mismatches = 0;
+    double spent = 0;
+
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        const double start = seconds();
+        for (size_t y = 0; y < rows; y++)
+        {
+            for (size_t x = 0; x < columns; x++)
+            {
+                line[x] = (char)('A' + (x + y + frame) % 26);
+            }
+
+            const uint8_t color = (uint8_t)(0x10 + (y + frame) % 7);
+            if (runs)
+            {
+                terminal_write_run(0, y, color, line, columns);
+            }
+            else
+            {
+                for (size_t x = 0; x < columns; x++)
+                {
+                    terminal_putentryat(line[x], color, x, y);
+                }
+            }
+        }
+        terminal_flush();
+        spent += seconds() - start;
+
+        if (frame % SAMPLE_EVERY == 0)
+        {
+            const uint64_t hash = display_model_hash(0);
+            if (!runs)
+            {
+                _samples[frame / SAMPLE_EVERY] = hash;
+            }
+            else if (_samples[frame / SAMPLE_EVERY] != hash)
+            {
+                fprintf(stdout, "frame %d: runs drew different pixels\n", frame);
+                mismatches++;
+            }
+        }
+    }
+
+    *out_seconds = spent;
+    return mismatches;
+}
+
+int main(void)
+{
+    terminal_initialize();
+
+    double cells, runs;
+    rewrite(false, &cells);
+    const int mismatches = rewrite(true, &runs);
+
+    fprintf(stdout, "full-screen rewrite, %d frames: per cell %.3fs, runs %.3fs\n", FRAMES, cells, runs);
+    fprintf(stdout, "runs: %s\n", mismatches == 0 ? "ok" : "FAILED");
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,625 @@
+// Stratus: virtio_gpu_device.c
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "virtio_gpu_device.h"
+#include "virtio_mmio.h"
+
+#define PACKED __attribute__((packed))
+
+#define GPU_DEVICE_ID 16u
+
+#define CMD_GET_DISPLAY_INFO      0x0100u
+#define CMD_RESOURCE_CREATE_2D    0x0101u
+#define CMD_RESOURCE_UNREF        0x0102u
+#define CMD_SET_SCANOUT           0x0103u
+#define CMD_RESOURCE_FLUSH        0x0104u
+#define CMD_TRANSFER_TO_HOST_2D   0x0105u
+#define CMD_RESOURCE_ATTACH       0x0106u
+#define CMD_RESOURCE_DETACH       0x0107u
+#define CMD_RESOURCE_CREATE_BLOB  0x010cu
+#define CMD_SET_SCANOUT_BLOB      0x010du
+
+#define RESP_OK_NODATA            0x1100u
+#define RESP_OK_DISPLAY_INFO      0x1101u
+#define RESP_ERR_UNSPEC           0x1200u
+
+#define FEATURE_VERSION_1         (1ull << 32)
+#define FEATURE_RESOURCE_BLOB     (1ull << 3)
+
+#define REGISTER_STATUS           0x070u
+#define REGISTER_EVENTS_READ      0x100u
+#define REGISTER_EVENTS_CLEAR     0x104u
+#define REGISTER_NUM_SCANOUTS     0x108u
+
+#define MAX_HEADS     16u
+#define MAX_RESOURCES 64u
+
+// the wire layouts, as the device sees them
+typedef struct PACKED
+{
+    uint32_t type;
+    uint32_t flags;
+    uint64_t fence_id;
+    uint32_t context_id;
+    uint32_t padding;
+} Header;
+
+typedef struct PACKED
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} Rect;
+
+typedef struct PACKED
+{
+    uint64_t address;
+    uint32_t length;
+    uint32_t padding;
+} MemoryEntry;
+
+typedef struct PACKED
+{
+    Header header;
+    struct PACKED
+    {
+        Rect rect;
+        uint32_t enabled;
+        uint32_t flags;
+    } modes[MAX_HEADS];
+} DisplayInfo;
+
+typedef struct PACKED
+{
+    Header header;
+    uint32_t resource_id;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+} Create2D;
+
+typedef struct PACKED
+{
+    Header header;
+    uint32_t resource_id;
+    uint32_t entry_count;
+} Attach;
+
+typedef struct PACKED
+{
+    Header header;
+    uint32_t resource_id;
+    uint32_t blob_mem;
+    uint32_t blob_flags;
+    uint32_t entry_count;
+    uint64_t blob_id;
+    uint64_t size;
+} CreateBlob;
+
+typedef struct PACKED
+{
+    Header header;
+    Rect rect;
+    uint32_t scanout_id;
+    uint32_t resource_id;
+} SetScanout;
+
+typedef struct PACKED
+{
+    Header header;
+    Rect rect;
+    uint32_t scanout_id;
+    uint32_t resource_id;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t padding;
+    uint32_t strides[4];
+    uint32_t offsets[4];
+} SetScanoutBlob;
+
+typedef struct PACKED
+{
+    Header header;
+    Rect rect;
+    uint64_t offset;
+    uint32_t resource_id;
+    uint32_t padding;
+} Transfer;
+
+typedef struct PACKED
+{
+    Header header;
+    Rect rect;
+    uint32_t resource_id;
+    uint32_t padding;
+} Flush;
+
+typedef struct PACKED
+{
+    Header header;
+    uint32_t resource_id;
+    uint32_t padding;
+} Reference;
+
+typedef struct
+{
+    bool exists;
+    bool blob;
+    uint32_t width;
+    uint32_t height;
+    // host copy of a 2D resource
+    uint32_t* pixels;
+    MemoryEntry* entries;
+    uint32_t entry_count;
+} Resource;
+
+typedef struct
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t resource_id;
+    // blob scanouts only
+    uint32_t stride;
+    uint32_t offset;
+} Head;
+
+static uint32_t _registers[0x200u / 4u];
+static bool _offer_blob;
+static uint32_t _head_count;
+static Head _heads[MAX_HEADS];
+static Resource _resources[MAX_RESOURCES];
+static uint32_t _errors;
+
+static ViQueue* _queue;
+// available entries the driver has notified, and how far the device got
+static uint16_t _notified;
+static uint16_t _consumed;
+
+static void device_error(const char* what, uint32_t value)
+{
+    fprintf(stderr, "device: %s (%u)\n", what, (unsigned)value);
+    _errors++;
+}
+
+void gpu_device_configure(uint32_t heads, const uint32_t* widths, const uint32_t* heights, bool blob)
+{
+    _head_count = heads;
+    _offer_blob = blob;
+    for (uint32_t i = 0; i < heads; i++)
+    {
+        _heads[i].width = widths[i];
+        _heads[i].height = heights[i];
+    }
+    _registers[REGISTER_NUM_SCANOUTS / 4u] = heads;
+}
+
+void gpu_device_set_mode(uint32_t scanout, uint32_t width, uint32_t height)
+{
+    _heads[scanout].width = width;
+    _heads[scanout].height = height;
+    _registers[REGISTER_EVENTS_READ / 4u] |= 1u;
+}
+
+uint32_t gpu_device_errors(void)
+{
+    return _errors;
+}
+
+static Resource* find_resource(uint32_t id)
+{
+    if (id == 0 || id >= MAX_RESOURCES || !_resources[id].exists)
+    {
+        device_error("no such resource", id);
+        return (Resource*)0;
+    }
+    return &_resources[id];
+}
+
+// the backing as one linear range, the way the device addresses it
+static uint8_t* backing_byte(const Resource* resource, uint64_t offset)
+{
+    for (uint32_t i = 0; i < resource->entry_count; i++)
+    {
+        if (offset < resource->entries[i].length)
+        {
+            return (uint8_t*)(uintptr_t)resource->entries[i].address + offset;
+        }
+        offset -= resource->entries[i].length;
+    }
+    return (uint8_t*)0;
+}
+
+static bool copy_entries(Resource* resource, const MemoryEntry* entries, uint32_t count)
+{
+    free(resource->entries);
+    resource->entries = calloc(count ? count : 1u, sizeof(MemoryEntry));
+    memcpy(resource->entries, entries, count * sizeof(MemoryEntry));
+    resource->entry_count = count;
+    return true;
+}
+
+static bool run_transfer(const Transfer* transfer)
+{
+    Resource* resource = find_resource(transfer->resource_id);
+    if (!resource || resource->blob || resource->entry_count == 0)
+    {
+        return false;
+    }
+
+    const Rect* rect = &transfer->rect;
+    if (rect->x + rect->width > resource->width || rect->y + rect->height > resource->height)
+    {
+        device_error("transfer out of bounds", transfer->resource_id);
+        return false;
+    }
+
+    const uint32_t stride = resource->width * 4u;
+    for (uint32_t row = 0; row < rect->height; row++)
+    {
+        uint32_t* destination = &resource->pixels[(rect->y + row) * resource->width + rect->x];
+        for (uint32_t column = 0; column < rect->width; column++)
+        {
+            const uint8_t* source = backing_byte(resource, transfer->offset + (uint64_t)row * stride + column * 4u);
+            if (!source)
+            {
+                device_error("transfer past backing", transfer->resource_id);
+                return false;
+            }
+            memcpy(&destination[column], source, 4u);
+        }
+    }
+    return true;
+}
+
+static bool run_command(const void* request, uint32_t length, void* response)
+{
+    // the driver acknowledges display events before asking for the modes
+    _registers[REGISTER_EVENTS_READ / 4u] &= ~_registers[REGISTER_EVENTS_CLEAR / 4u];
+    _registers[REGISTER_EVENTS_CLEAR / 4u] = 0;
+
+    const Header* header = (const Header*)request;
+    Header* reply = (Header*)response;
+    reply->type = RESP_OK_NODATA;
+    reply->flags = header->flags;
+    reply->fence_id = header->fence_id;
+
+    switch (header->type)
+    {
+        case CMD_GET_DISPLAY_INFO:
+        {
+            DisplayInfo* info = (DisplayInfo*)response;
+            info->header.type = RESP_OK_DISPLAY_INFO;
+            for (uint32_t i = 0; i < _head_count; i++)
+            {
+                info->modes[i].rect.width = _heads[i].width;
+                info->modes[i].rect.height = _heads[i].height;
+                info->modes[i].enabled = _heads[i].width != 0;
+            }
+            return true;
+        }
+
+        case CMD_RESOURCE_CREATE_2D:
+        {
+            const Create2D* create = (const Create2D*)request;
+            if (create->resource_id == 0 || create->resource_id >= MAX_RESOURCES || _resources[create->resource_id].exists)
+            {
+                return false;
+            }
+            Resource* resource = &_resources[create->resource_id];
+            memset(resource, 0, sizeof(*resource));
+            resource->exists = true;
+            resource->width = create->width;
+            resource->height = create->height;
+            resource->pixels = calloc((size_t)create->width * create->height, 4u);
+            return true;
+        }
+
+        case CMD_RESOURCE_CREATE_BLOB:
+        {
+            const CreateBlob* create = (const CreateBlob*)request;
+            if (!_offer_blob || create->resource_id == 0 || create->resource_id >= MAX_RESOURCES || _resources[create->resource_id].exists)
+            {
+                return false;
+            }
+            Resource* resource = &_resources[create->resource_id];
+            memset(resource, 0, sizeof(*resource));
+            resource->exists = true;
+            resource->blob = true;
+            return copy_entries(resource, (const MemoryEntry*)(create + 1), create->entry_count);
+        }
+
+        case CMD_RESOURCE_ATTACH:
+        {
+            const Attach* attach = (const Attach*)request;
+            Resource* resource = find_resource(attach->resource_id);
+            if (!resource || length < sizeof(*attach) + attach->entry_count * sizeof(MemoryEntry))
+            {
+                return false;
+            }
+            return copy_entries(resource, (const MemoryEntry*)(attach + 1), attach->entry_count);
+        }
+
+        case CMD_RESOURCE_DETACH:
+        {
+            Resource* resource = find_resource(((const Reference*)request)->resource_id);
+            if (!resource)
+            {
+                return false;
+            }
+            resource->entry_count = 0;
+            return true;
+        }
+
+        case CMD_RESOURCE_UNREF:
+        {
+            Resource* resource = find_resource(((const Reference*)request)->resource_id);
+            if (!resource)
+            {
+                return false;
+            }
+            for (uint32_t i = 0; i < _head_count; i++)
+            {
+                if (_heads[i].resource_id == ((const Reference*)request)->resource_id)
+                {
+                    device_error("unref of a scanned out resource", _heads[i].resource_id);
+                }
+            }
+            free(resource->pixels);
+            free(resource->entries);
+            memset(resource, 0, sizeof(*resource));
+            return true;
+        }
+
+        case CMD_SET_SCANOUT:
+        {
+            const SetScanout* set = (const SetScanout*)request;
+            if (set->scanout_id >= _head_count || (set->resource_id != 0 && !find_resource(set->resource_id)))
+            {
+                return false;
+            }
+            _heads[set->scanout_id].resource_id = set->resource_id;
+            return true;
+        }
+
+        case CMD_SET_SCANOUT_BLOB:
+        {
+            const SetScanoutBlob* set = (const SetScanoutBlob*)request;
+            Resource* resource = find_resource(set->resource_id);
+            if (set->scanout_id >= _head_count || !resource || !resource->blob)
+            {
+                return false;
+            }
+            resource->width = set->width;
+            resource->height = set->height;
+            _heads[set->scanout_id].resource_id = set->resource_id;
+            _heads[set->scanout_id].stride = set->strides[0];
+            _heads[set->scanout_id].offset = set->offsets[0];
+            return true;
+        }
+
+        case CMD_TRANSFER_TO_HOST_2D:
+            return run_transfer((const Transfer*)request);
+
+        case CMD_RESOURCE_FLUSH:
+            return find_resource(((const Flush*)request)->resource_id) != 0;
+
+        default:
+            device_error("unknown command", header->type);
+            return false;
+    }
+}
+
+static void run_next(void)
+{
+    const uint16_t size = _queue->queue_size;
+    const uint16_t head = _queue->available->ring[_consumed % size];
+    _consumed++;
+
+    const VqDescriptor* request = &_queue->descriptor[head];
+    const VqDescriptor* response = &_queue->descriptor[request->next];
+    if (!(request->flags & VIRTQ_DESC_F_NEXT) || !(response->flags & VIRTQ_DESC_F_WRITE))
+    {
+        device_error("bad chain", head);
+        return;
+    }
+
+    void* reply = (void*)(uintptr_t)response->address;
+    if (!run_command((const void*)(uintptr_t)request->address, request->length, reply))
+    {
+        ((Header*)reply)->type = RESP_ERR_UNSPEC;
+    }
+
+    VqConsumed* used = _queue->used;
+    used->ring[used->index % size].id = head;
+    used->ring[used->index % size].length = response->length;
+    used->index++;
+}
+
+void gpu_device_drain(void)
+{
+    while (_queue && _consumed != _notified)
+    {
+        run_next();
+    }
+}
+
+uint32_t gpu_device_pending(void)
+{
+    return (uint16_t)(_notified - _consumed);
+}
+
+bool gpu_device_pixel(uint32_t scanout, uint32_t x, uint32_t y, uint32_t* out_pixel)
+{
+    const Head* head = &_heads[scanout];
+    if (scanout >= _head_count || head->resource_id == 0 || x >= head->width || y >= head->height)
+    {
+        return false;
+    }
+
+    const Resource* resource = &_resources[head->resource_id];
+    if (!resource->blob)
+    {
+        *out_pixel = resource->pixels[y * resource->width + x];
+        return true;
+    }
+
+    const uint8_t* source = backing_byte(resource, head->offset + (uint64_t)y * head->stride + x * 4u);
+    if (!source)
+    {
+        return false;
+    }
+    memcpy(out_pixel, source, 4u);
+    return true;
+}
+
+// transport
+
+bool virtio_mmio_find_device(uint32_t device_id, ViMMIODevice* out_dev)
+{
+    if (device_id != GPU_DEVICE_ID || _head_count == 0)
+    {
+        return false;
+    }
+
+    memset(out_dev, 0, sizeof(*out_dev));
+    out_dev->base = (uintptr_t)_registers;
+    out_dev->version = 2;
+    out_dev->irq = 1;
+    return true;
+}
+
+bool virtio_mmio_init(ViMMIODevice* device)
+{
+    (void)device;
+    return true;
+}
+
+bool virtio_mmio_negotiate(ViMMIODevice* device, uint64_t wanted_features, uint64_t* out_accepted)
+{
+    (void)device;
+    const uint64_t offered = FEATURE_VERSION_1 | (_offer_blob ? FEATURE_RESOURCE_BLOB : 0u);
+    if (out_accepted)
+    {
+        *out_accepted = wanted_features & offered;
+    }
+    return true;
+}
+
+// only the control queue exists, so the driver runs without a cursor
+bool virtq_init(ViMMIODevice* device, uint32_t queue_index, uint16_t queue_size, ViQueue* out_q)
+{
+    if (queue_index != 0)
+    {
+        return false;
+    }
+
+    memset(out_q, 0, sizeof(*out_q));
+    out_q->device = device;
+    out_q->queue_index = queue_index;
+    out_q->queue_size = queue_size;
+    out_q->descriptor = calloc(queue_size, sizeof(VqDescriptor));
+    out_q->available = calloc(1, sizeof(VqAvailable) + queue_size * sizeof(uint16_t));
+    out_q->used = calloc(1, sizeof(VqConsumed) + queue_size * sizeof(VqConsumedElement));
+    out_q->free_next = calloc(queue_size, sizeof(uint16_t));
+    out_q->submit_time = calloc(queue_size, sizeof(uint32_t));
+
+    for (uint16_t i = 0; i < queue_size; i++)
+    {
+        out_q->free_next[i] = (i + 1u < queue_size) ? (uint16_t)(i + 1u) : 0xffffu;
+    }
+    out_q->free_head = 0;
+    out_q->number_free = queue_size;
+
+    _queue = out_q;
+    return true;
+}
+
+int virtq_alloc_chain(ViQueue* q, uint16_t count)
+{
+    if (q->number_free < count || count == 0)
+    {
+        q->stats.ring_full++;
+        return -1;
+    }
+
+    uint16_t head = q->free_head;
+    uint16_t index = head;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const uint16_t next = q->free_next[index];
+        memset(&q->descriptor[index], 0, sizeof(VqDescriptor));
+        if (i + 1u < count)
+        {
+            q->descriptor[index].flags = VIRTQ_DESC_F_NEXT;
+            q->descriptor[index].next = next;
+            index = next;
+        }
+        else
+        {
+            q->free_head = next;
+        }
+    }
+    q->number_free = (uint16_t)(q->number_free - count);
+    return head;
+}
+
+void virtq_free_chain(ViQueue* q, uint16_t head)
+{
+    uint16_t current = head;
+    while (current != 0xffffu)
+    {
+        const uint16_t next = (q->descriptor[current].flags & VIRTQ_DESC_F_NEXT) ? q->descriptor[current].next : 0xffffu;
+        memset(&q->descriptor[current], 0, sizeof(VqDescriptor));
+        q->free_next[current] = q->free_head;
+        q->free_head = current;
+        q->number_free++;
+        current = next;
+    }
+}
+
+void virtq_submit(ViQueue* q, uint16_t head)
+{
+    q->available->ring[q->available->index % q->queue_size] = head;
+    q->available->index++;
+    q->stats.submits++;
+}
+
+void virtq_notify(ViQueue* q)
+{
+    _notified = q->available->index;
+    q->stats.notifies++;
+}
+
+// the device catches up one command at a time, only when asked
+bool virtq_poll_used(ViQueue* q, uint16_t* out_id)
+{
+    if (q->last_used_index == q->used->index && _consumed != _notified)
+    {
+        run_next();
+    }
+
+    if (q->last_used_index == q->used->index)
+    {
+        return false;
+    }
+
+    const VqConsumedElement element = q->used->ring[q->last_used_index % q->queue_size];
+    q->last_used_index++;
+    q->stats.completions++;
+    if (out_id)
+    {
+        *out_id = (uint16_t)element.id;
+    }
+    return true;
+}
+
+void virtq_set_mode(ViQueue* q, ViQueueMode mode)
+{
+    q->mode = mode;
+}
@@ -0,0 +1,32 @@
+#ifndef STRATUS_VIRTIO_GPU_DEVICE_H
+#define STRATUS_VIRTIO_GPU_DEVICE_H
+
+// Stratus: virtio_gpu_device.h
+// (c) 2026 Connor J. Link. All Rights Reserved.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A host model of the virtio-gpu device behind the virtq API, so the real
+// driver can run on the build machine. Commands are only looked at once they
+// have been notified, and are executed lazily as the driver polls for used
+// buffers: a transfer reads guest memory at that point, not at submit time.
+
+// Must be called before virtio_gpu_init.
+void gpu_device_configure(uint32_t heads, const uint32_t* widths, const uint32_t* heights, bool blob);
+
+// Changes one head's mode and raises the display event.
+void gpu_device_set_mode(uint32_t scanout, uint32_t width, uint32_t height);
+
+// Executes every notified command.
+void gpu_device_drain(void);
+// Notified commands the device has not got to yet.
+uint32_t gpu_device_pending(void);
+
+// What the head currently shows: the host copy of a 2D resource, or the guest
+// memory a blob is scanned out from.
+bool gpu_device_pixel(uint32_t scanout, uint32_t x, uint32_t y, uint32_t* out_pixel);
+
+uint32_t gpu_device_errors(void);
+
+#endif